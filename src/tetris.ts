@@ -1,4 +1,13 @@
-import Module, { Board } from '../wasm/tetris.js';
+import type { Board } from '../wasm/tetris.js';
+
+// (func (result v128) i32.const 0 i8x16.splat i8x16.popcnt); only validates with SIMD128 support
+const SIMD_PROBE = new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11,
+]);
+
+const { default: Module } = WebAssembly.validate(SIMD_PROBE)
+    ? await import('../wasm/tetris-simd.js')
+    : await import('../wasm/tetris.js');
 
 export const module = await Module();
 
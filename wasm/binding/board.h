@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../tetris/board.h"
+#include "../tetris/board_features.h"
 
 std::unique_ptr<Board> CreateBoard();
 std::unique_ptr<Board> BoardFromBytes(const std::vector<uint8_t>& buf);
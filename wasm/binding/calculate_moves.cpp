@@ -1,35 +1,305 @@
 #include "calculate_moves.h"
+#include "../tetris/taps.h"
 
 #include <map>
+#include <mutex>
+#include <atomic>
 #include <bitset>
 #include <unordered_map>
 
-struct PrecomputedTableCache {
-  struct PrecomputedTableKey {
+namespace {
+
+// Tables for the web app's default reaction time (21 frames, index 2 of
+//   REACTION_TIMES in src/params.ts) are generated at compile time, so the
+//   first queries with any tap speed do not build them. The baked keys
+//   (tap speed, level, adj frame) are every TapSpeed (10, 12, 15, 20, 24 and
+//   30 Hz, slow 5 tap) at every level (18, 19, 29, 39) with adj frame 21, 28
+//   in all. Baking every reaction time as well is not worthwhile: that is
+//   ~25 MB of tables.
+struct BakedTables {
+  Level level;
+  int adj_frame;
+  TapSpeed tap_speed;
+  PrecomputedTable (*get[3])(); // R = 1, 2, 4
+};
+
+template <Level level, int adj_frame, TapSpeed tap_speed>
+constexpr BakedTables MakeBakedTables() {
+  using namespace move_search;
+  constexpr auto taps = kTapTables[tap_speed];
+  return {level, adj_frame, tap_speed, {
+      BakedPhase1Table<level, 1, adj_frame, taps>::Get,
+      BakedPhase1Table<level, 2, adj_frame, taps>::Get,
+      BakedPhase1Table<level, 4, adj_frame, taps>::Get}};
+}
+
+constexpr int kBakedAdjFrame = 21;
+
+// every (tap speed, level) pair; index i is TapSpeed i / 4 at Level i % 4
+template <size_t... i>
+constexpr std::array<BakedTables, sizeof...(i)> MakeAllBakedTables(std::index_sequence<i...>) {
+  return {MakeBakedTables<(Level)(i % 4), kBakedAdjFrame, (TapSpeed)(i / 4)>()...};
+}
+
+constexpr auto kBakedTables = MakeAllBakedTables(std::make_index_sequence<kTapSpeeds * 4>());
+
+} // namespace
+
+// Tables by (level, adj_frame, taps), shared by all threads.
+// - A table is built once per key: racing threads wait on the same slot.
+// - The slots are published as an immutable snapshot, replaced (under the
+//   lock) whenever a slot is added or dropped. Each thread keeps a copy of the
+//   snapshot and looks it up without the lock while the generation is
+//   unchanged, so only lookups after a change take the lock.
+// - Every lookup stamps the slot, and the least recently stamped tables are
+//   dropped beyond the byte budget. A search holds a shared_ptr, so a table
+//   dropped meanwhile stays valid; it is freed once the searches and the
+//   threads' old snapshots (dropped at their next lookup) release it.
+class PrecomputedTableCache {
+  struct Key {
     Level level;
     int adj_frame;
     std::array<int, 10> taps;
 
-    auto operator<=>(const PrecomputedTableKey&) const = default;
+    auto operator<=>(const Key&) const = default;
   };
-  std::map<PrecomputedTableKey, PrecomputedTableTuple> mp;
+  using TablePtr = std::shared_ptr<const PrecomputedTableTuple>;
+  struct Slot {
+    std::once_flag once;
+    TablePtr table;
+    size_t bytes = 0; // with mutex_ held; 0 while the table is being built
+    std::atomic<uint64_t> last_used{0};
+  };
+  using Snapshot = std::map<Key, std::shared_ptr<Slot>>;
+  using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+  std::mutex mutex_;
+  SnapshotPtr snapshot_ = std::make_shared<const Snapshot>();
+  size_t bytes_ = 0, tables_ = 0;
+  size_t budget_ = kDefaultBudget;
+  // bumped whenever snapshot_ is replaced
+  std::atomic<uint64_t> generation_{0};
+  std::atomic<uint64_t> clock_{0};
+  std::atomic<uint64_t> hits_{0}, misses_{0}, evictions_{0};
+
+  static TablePtr Build_(const Key& key) {
+    for (auto& i : kBakedTables) {
+      if (i.level == key.level && i.adj_frame == key.adj_frame && kTapTables[i.tap_speed] == key.taps) {
+        return std::make_shared<const PrecomputedTableTuple>(i.get[0](), i.get[1](), i.get[2]());
+      }
+    }
+    return std::make_shared<const PrecomputedTableTuple>(key.level, key.adj_frame, key.taps.data());
+  }
+
+  // with mutex_ held
+  void Publish_(Snapshot&& snapshot) {
+    snapshot_ = std::make_shared<const Snapshot>(std::move(snapshot));
+    generation_.fetch_add(1, std::memory_order_release);
+  }
 
-  const PrecomputedTableTuple& operator()(Level level, int adj_frame, const std::array<int, 10>& taps) {
-    PrecomputedTableKey key{level, adj_frame, taps};
-    if (auto it = mp.find(key); it != mp.end()) {
+  // with mutex_ held
+  void Evict_() {
+    if (bytes_ <= budget_ || tables_ <= 1) return;
+    Snapshot snapshot = *snapshot_;
+    while (bytes_ > budget_ && tables_ > 1) {
+      auto oldest = snapshot.end();
+      for (auto it = snapshot.begin(); it != snapshot.end(); ++it) {
+        if (it->second->bytes && (oldest == snapshot.end() ||
+              it->second->last_used.load(std::memory_order_relaxed) <
+              oldest->second->last_used.load(std::memory_order_relaxed))) {
+          oldest = it;
+        }
+      }
+      bytes_ -= oldest->second->bytes;
+      tables_--;
+      snapshot.erase(oldest);
+      evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    Publish_(std::move(snapshot));
+  }
+
+  std::shared_ptr<Slot> Insert_(const Key& key) {
+    std::lock_guard lock(mutex_);
+    // another thread may have added it since our snapshot
+    auto it = snapshot_->find(key);
+    if (it != snapshot_->end()) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
       return it->second;
     }
-    PrecomputedTableTuple table(level, adj_frame, taps.data());
-    auto it = mp.insert({key, std::move(table)});
-    return it.first->second;
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    auto slot = std::make_shared<Slot>();
+    Snapshot snapshot = *snapshot_;
+    snapshot.emplace(key, slot);
+    Publish_(std::move(snapshot));
+    return slot;
+  }
+
+ public:
+  static constexpr size_t kDefaultBudget = 64 << 20;
+
+  TablePtr operator()(Level level, int adj_frame, const std::array<int, 10>& taps) {
+    CheckTaps(taps);
+    Key key{level, adj_frame, taps};
+    thread_local SnapshotPtr snapshot;
+    thread_local uint64_t snapshot_generation;
+    if (!snapshot || snapshot_generation != generation_.load(std::memory_order_acquire)) {
+      std::lock_guard lock(mutex_);
+      snapshot = snapshot_;
+      snapshot_generation = generation_.load(std::memory_order_relaxed);
+    }
+    std::shared_ptr<Slot> slot;
+    if (auto it = snapshot->find(key); it != snapshot->end()) {
+      slot = it->second;
+      hits_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      slot = Insert_(key);
+    }
+    slot->last_used.store(clock_.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    bool built = false;
+    // if building throws, the next caller of call_once retries
+    std::call_once(slot->once, [&]() {
+      slot->table = Build_(key);
+      built = true;
+    });
+    if (built) {
+      std::lock_guard lock(mutex_);
+      auto it = snapshot_->find(key);
+      if (it != snapshot_->end() && it->second == slot) {
+        slot->bytes = sizeof(PrecomputedTableTuple) + slot->table->HeapBytes();
+        bytes_ += slot->bytes;
+        tables_++;
+        Evict_();
+      }
+    }
+    return slot->table;
+  }
+
+  void SetBudget(size_t bytes) {
+    std::lock_guard lock(mutex_);
+    budget_ = bytes;
+    Evict_();
+  }
+
+  TableCacheStats GetStats() {
+    std::lock_guard lock(mutex_);
+    return {hits_.load(), misses_.load(), evictions_.load(), bytes_, tables_};
   }
 } precomputed_table_cache;
 
 PossibleMoves MoveSearch(
     Level level, int adj_frame, const std::array<int, 10>& taps,
     const Board& b, int piece) {
-  auto& table = precomputed_table_cache(level, adj_frame, taps);
-  return MoveSearch(level, adj_frame, taps.data(), table, b, piece);
+  // successive calls are often on the same board with a cell or two edited
+  //   (board editor), so reuse the masks of the previous board
+  thread_local MoveSearchContext context;
+  auto table = precomputed_table_cache(level, adj_frame, taps);
+  return context.Search(level, adj_frame, taps.data(), *table, b, piece);
+}
+
+void MoveSearch(
+    Level level, int adj_frame, const std::array<int, 10>& taps,
+    const Board& b, int piece, CompactPossibleMoves& ret) {
+  auto table = precomputed_table_cache(level, adj_frame, taps);
+  MoveSearch(level, adj_frame, taps.data(), *table, b, piece, ret);
+}
+
+void MoveSearch(
+    Level level, int adj_frame, const std::array<int, 10>& taps,
+    const Board& b, int piece, BitboardPossibleMoves& ret) {
+  auto table = precomputed_table_cache(level, adj_frame, taps);
+  MoveSearch(level, adj_frame, taps.data(), *table, b, piece, ret);
+}
+
+std::array<PossibleMoves, kPieces> MoveSearchAllPieces(
+    const Board& b, Level level, int adj_frame, const std::array<int, 10>& taps) {
+  auto table = precomputed_table_cache(level, adj_frame, taps);
+  return MoveSearchAllPieces(level, adj_frame, taps.data(), *table, b);
+}
+
+void MoveSearchSweep(
+    const Board& b, int piece, int adj_frame, std::span<const std::array<int, 10>> taps_list,
+    std::vector<BitboardPossibleMoves>& ret) {
+  int n = taps_list.size();
+  ret.resize(4 * n);
+  std::vector<const int*> taps(n);
+  std::vector<std::shared_ptr<const PrecomputedTableTuple>> holders(n);
+  std::vector<const PrecomputedTableTuple*> tables(n);
+  for (int level = 0; level < 4; level++) {
+    for (int i = 0; i < n; i++) {
+      taps[i] = taps_list[i].data();
+      holders[i] = precomputed_table_cache((Level)level, adj_frame, taps_list[i]);
+      tables[i] = holders[i].get();
+    }
+    MoveSearchTaps((Level)level, adj_frame, n, taps.data(), tables.data(), b, piece, ret.data() + level * n);
+  }
+}
+
+void CheckTaps(const std::array<int, 10>& taps) {
+  // frames are bit indices of 64-bit masks in the search
+  constexpr int kMaxTapFrame = 63;
+  for (int i = 0; i < 10; i++) {
+    if (taps[i] < 0 || taps[i] > kMaxTapFrame || (i && taps[i] <= taps[i - 1])) {
+      throw std::runtime_error("taps must be increasing and within range");
+    }
+  }
+}
+
+TableCacheStats GetTableCacheStats() {
+  return precomputed_table_cache.GetStats();
+}
+
+void SetTableCacheBudget(size_t bytes) {
+  precomputed_table_cache.SetBudget(bytes);
+}
+
+void ComputeReachabilityFrontier(
+    const Board& b, int piece, Level level, std::span<const std::array<int, 10>> taps_list,
+    ReachabilityFrontier& ret) {
+  std::vector<const int*> taps(taps_list.size());
+  for (size_t i = 0; i < taps_list.size(); i++) {
+    CheckTaps(taps_list[i]);
+    taps[i] = taps_list[i].data();
+  }
+  ComputeReachabilityFrontier(level, taps.size(), taps.data(), b, piece, ret);
+}
+
+namespace {
+
+// the search indexes its tables with these, so they are checked before
+void CheckPlacementQuery(int piece, Level level, const PlacementQuery& query) {
+  if (piece < 0 || piece >= (int)kPieces) throw std::runtime_error("invalid piece");
+  if (level < kLevel18 || level > kLevel39) throw std::runtime_error("invalid level");
+  auto OnBoard = [&](const Position& pos) {
+    return pos.r >= 0 && pos.r < Board::NumRotations(piece) && pos.x >= 0 && pos.x < 20 && pos.y >= 0 && pos.y < 10;
+  };
+  if (!OnBoard(query.target) || (query.premove != Position::Invalid && !OnBoard(query.premove))) {
+    throw std::runtime_error("position out of range");
+  }
+}
+
+} // namespace
+
+PlacementCheck IsReachable(
+    const Board& b, int piece, Level level, int adj_frame, const std::array<int, 10>& taps,
+    const Position& target, const Position& premove) {
+  CheckPlacementQuery(piece, level, {target, premove});
+  auto table = precomputed_table_cache(level, adj_frame, taps);
+  return IsReachable(level, adj_frame, taps.data(), *table, b, piece, target, premove);
+}
+
+void IsReachable(
+    const Board& b, int piece, Level level, int adj_frame, const std::array<int, 10>& taps,
+    std::span<const PlacementQuery> queries, std::span<PlacementCheck> ret) {
+  if (ret.size() < queries.size()) throw std::runtime_error("output too small");
+  for (auto& query : queries) CheckPlacementQuery(piece, level, query);
+  auto table = precomputed_table_cache(level, adj_frame, taps);
+  IsReachable(level, adj_frame, taps.data(), *table, b, piece, queries.size(), queries.data(), ret.data());
+}
+
+void GenerateSuccessors(
+    const Board& b, int piece, Level level, int adj_frame, const std::array<int, 10>& taps, Successors& ret) {
+  auto table = precomputed_table_cache(level, adj_frame, taps);
+  GenerateSuccessors(level, adj_frame, taps.data(), *table, b, piece, ret);
 }
 
 std::pair<PossibleMoves, MoveMap> CalculateMoves(
@@ -1,14 +1,67 @@
 #pragma once
 
+#include <span>
+
 #include "../tetris/game.h"
 #include "../tetris/board.h"
 #include "../tetris/position.h"
 #include "../tetris/move_search_no_tmpl.h"
+#include "../tetris/successors.h"
+#include "../tetris/reachability.h"
+#include "../tetris/point_query.h"
 
 using MoveMap = std::array<ByteBoard, 4>;
 constexpr uint8_t kNoAdj = 1;
 constexpr uint8_t kHasAdjReduced = 2;
 constexpr uint8_t kHasAdjNonReduced = 3;
 
+// The tables of each (level, adj_frame, taps) are built on first use and kept
+//   in a cache shared by all threads, within a memory budget. taps can be any
+//   increasing table of frames 0-63 (std::runtime_error otherwise).
+struct TableCacheStats {
+  uint64_t hits, misses, evictions;
+  size_t bytes, tables;
+};
+void CheckTaps(const std::array<int, 10>& taps);
+TableCacheStats GetTableCacheStats();
+// drops the least recently used tables until they fit
+void SetTableCacheBudget(size_t bytes);
+
+// search with the tables from the cache, without allocating
+void MoveSearch(
+    Level level, int adj_frame, const std::array<int, 10>& taps,
+    const Board& b, int piece, CompactPossibleMoves& ret);
+void MoveSearch(
+    Level level, int adj_frame, const std::array<int, 10>& taps,
+    const Board& b, int piece, BitboardPossibleMoves& ret);
+
+std::array<PossibleMoves, kPieces> MoveSearchAllPieces(
+    const Board& b, Level level, int adj_frame, const std::array<int, 10>& taps);
+
+// Search the piece at all four levels with each tap table in taps_list;
+//   ret[level * taps_list.size() + i] is the result at that level with
+//   taps_list[i]. The board preprocessing is shared by all tap tables of a level.
+void MoveSearchSweep(
+    const Board& b, int piece, int adj_frame, std::span<const std::array<int, 10>> taps_list,
+    std::vector<BitboardPossibleMoves>& ret);
+
+// For each tap table in taps_list, the adj frames that reach every placement
+//   (see ReachabilityFrontier); replaces searching at every adj frame.
+void ComputeReachabilityFrontier(
+    const Board& b, int piece, Level level, std::span<const std::array<int, 10>> taps_list,
+    ReachabilityFrontier& ret);
+
+// Whether target can be placed, without searching every placement; premove
+//   as in CalculateMoves. The batched version checks queries[i] into ret[i].
+PlacementCheck IsReachable(
+    const Board& b, int piece, Level level, int adj_frame, const std::array<int, 10>& taps,
+    const Position& target, const Position& premove = Position::Invalid);
+void IsReachable(
+    const Board& b, int piece, Level level, int adj_frame, const std::array<int, 10>& taps,
+    std::span<const PlacementQuery> queries, std::span<PlacementCheck> ret);
+
 std::pair<PossibleMoves, MoveMap> CalculateMoves(
     const Board& b, int now_piece, Level level, int adj_frame, const std::array<int, 10>& taps, const Position& premove);
+
+void GenerateSuccessors(
+    const Board& b, int piece, Level level, int adj_frame, const std::array<int, 10>& taps, Successors& ret);
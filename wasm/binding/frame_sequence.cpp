@@ -2,16 +2,17 @@
 
 #include <unordered_map>
 
-std::vector<AdjItem> GetBestAdjModes(
+std::vector<AdjItem> GetBestAdjModesWithTaps(
     const Board& board, int now_piece,
-    int lines, TapSpeed tap_speed, int adj_delay,
+    int lines, const std::array<int, 10>& taps, int adj_delay,
     const PossibleMoves& moves, const std::vector<Position>& adjs) {
   if (adjs.size() != kPieces) {
     throw std::runtime_error("adjs size must be 7");
   }
+  CheckTaps(taps);
   Level level = GetLevelSpeed(GetLevelByLines(lines));
   auto adj_infor = GetAdjTaps(
-      level, kTapTables[static_cast<int>(tap_speed)].data(), board, now_piece,
+      level, taps.data(), board, now_piece,
       moves, adj_delay, adjs.data());
   std::unordered_map<Position, AdjItem> ret_map;
   for (auto [mode_str, mode] : std::vector<std::pair<std::string, BestAdjMode>>{
@@ -45,3 +46,10 @@ std::vector<AdjItem> GetBestAdjModes(
   });
   return ret;
 }
+
+std::vector<AdjItem> GetBestAdjModes(
+    const Board& board, int now_piece,
+    int lines, TapSpeed tap_speed, int adj_delay,
+    const PossibleMoves& moves, const std::vector<Position>& adjs) {
+  return GetBestAdjModesWithTaps(board, now_piece, lines, kTapTables[tap_speed], adj_delay, moves, adjs);
+}
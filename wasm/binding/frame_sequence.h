@@ -13,3 +13,7 @@ std::vector<AdjItem> GetBestAdjModes(
     const Board& board, int now_piece,
     int lines, TapSpeed tap_speed, int adj_delay,
     const PossibleMoves& moves, const std::vector<Position>& adjs);
+std::vector<AdjItem> GetBestAdjModesWithTaps(
+    const Board& board, int now_piece,
+    int lines, const std::array<int, 10>& taps, int adj_delay,
+    const PossibleMoves& moves, const std::vector<Position>& adjs);
@@ -4,7 +4,7 @@ namespace {
 
 StateDetail GetState_(
     const Board& board, int now_piece, int next_piece, const Position& premove,
-    int lines, TapSpeed tap_speed, int adj_delay, int aggression_level) {
+    int lines, const std::array<int, 10>& taps, int adj_delay, int aggression_level) {
   State state = {};
   memset(state.board.data(), 0, sizeof(state.board));
 
@@ -20,7 +20,7 @@ StateDetail GetState_(
   // moves: shape (14, 20, 10) [board, one, moves(4), adj_moves(4), initial_move(4), nonreduce_moves(4)]
   // move_meta: shape (28,) [speed(4), to_transition(21), (level-18)*0.1, lines*0.01, pieces*0.004]
   auto [moves, move_map] = CalculateMoves(
-    board, now_piece, level_speed, adj_delay, kTapTables[static_cast<int>(tap_speed)],
+    board, now_piece, level_speed, adj_delay, taps,
     is_adj ? premove : Position::Invalid);
   {
     for (int i = 0; i < 20; i++) {
@@ -58,8 +58,8 @@ StateDetail GetState_(
   int state_level = GetLevelByLines(state_lines);
   int state_speed = static_cast<int>(GetLevelSpeed(state_level));
 
-  int tap_4 = kTapTables[tap_speed][3];
-  int tap_5 = kTapTables[tap_speed][4];
+  int tap_4 = taps[3];
+  int tap_5 = taps[4];
   if (state_speed == 2 && adj_delay >= 20) adj_delay = 61;
   if (state_speed == 3 && adj_delay >= 10) adj_delay = 61;
   if (tap_5 <= 8) { // 30hz
@@ -122,22 +122,30 @@ StateDetail GetState_(
 
 } // namespace
 
-StateDetail GetState(
+StateDetail GetStateWithTaps(
     const Board& board, int now_piece, int next_piece, const Position& premove,
-    int lines, TapSpeed tap_speed, int adj_delay, int aggression_level) {
+    int lines, const std::array<int, 10>& taps, int adj_delay, int aggression_level) {
   try {
     return GetState_(
         board, now_piece, next_piece, premove,
-        lines, tap_speed, adj_delay, aggression_level);
+        lines, taps, adj_delay, aggression_level);
   } catch (std::runtime_error&) {
     return {};
   }
 }
 
-MultiState GetStateAllNextPieces(
-    const Board& board, int now_piece, const Position& premove,
+StateDetail GetState(
+    const Board& board, int now_piece, int next_piece, const Position& premove,
     int lines, TapSpeed tap_speed, int adj_delay, int aggression_level) {
-  MultiState ret = GetState(board, now_piece, 0, premove, lines, tap_speed, adj_delay, aggression_level).state;
+  return GetStateWithTaps(
+      board, now_piece, next_piece, premove,
+      lines, kTapTables[tap_speed], adj_delay, aggression_level);
+}
+
+MultiState GetStateAllNextPiecesWithTaps(
+    const Board& board, int now_piece, const Position& premove,
+    int lines, const std::array<int, 10>& taps, int adj_delay, int aggression_level) {
+  MultiState ret = GetStateWithTaps(board, now_piece, 0, premove, lines, taps, adj_delay, aggression_level).state;
   ret.resize(7);
   for (int i = 1; i < 7; i++) {
     memcpy(ret.board[i].data(), ret.board[0].data(), sizeof(State::board));
@@ -150,3 +158,24 @@ MultiState GetStateAllNextPieces(
   }
   return ret;
 }
+
+MultiState GetStateAllNextPieces(
+    const Board& board, int now_piece, const Position& premove,
+    int lines, TapSpeed tap_speed, int adj_delay, int aggression_level) {
+  return GetStateAllNextPiecesWithTaps(
+      board, now_piece, premove, lines, kTapTables[tap_speed], adj_delay, aggression_level);
+}
+
+PlacementCheck IsReachableWithTaps(
+    const Board& board, int piece, const Position& target, const Position& premove,
+    int lines, const std::array<int, 10>& taps, int adj_delay) {
+  Level level_speed = GetLevelSpeed(GetLevelByLines(lines));
+  return IsReachable(board, piece, level_speed, adj_delay, taps, target, premove);
+}
+
+PlacementCheck IsReachable(
+    const Board& board, int piece, const Position& target, const Position& premove,
+    int lines, TapSpeed tap_speed, int adj_delay) {
+  if (tap_speed < 0 || tap_speed >= kTapSpeeds) throw std::runtime_error("invalid tap speed");
+  return IsReachableWithTaps(board, piece, target, premove, lines, kTapTables[tap_speed], adj_delay);
+}
@@ -2,27 +2,9 @@
 
 #include "../tetris/board.h"
 #include "../tetris/position.h"
+#include "../tetris/taps.h"
 #include "calculate_moves.h"
 
-enum TapSpeed {
-  kTap10Hz,
-  kTap12Hz,
-  kTap15Hz,
-  kTap20Hz,
-  kTap24Hz,
-  kTap30Hz,
-  kSlow5
-};
-constexpr std::array<int, 10> kTapTables[] = { // match TapSpeed
-  {0, 6, 12, 18, 24, 30, 36, 42, 48, 54},
-  {0, 5, 10, 15, 20, 25, 30, 35, 40, 45},
-  {0, 4, 8, 12, 16, 20, 24, 28, 32, 36},
-  {0, 3, 6, 9, 12, 15, 18, 21, 24, 27},
-  {0, 3, 5, 8, 10, 13, 15, 18, 20, 23},
-  {0, 2, 4, 6, 8, 10, 12, 14, 16, 18},
-  {0, 2, 4, 6, 18, 20, 22, 24, 36, 38}
-};
-
 struct State {
   std::array<std::array<std::array<float, 10>, 20>, 6> board;
   std::array<float, 32> meta;
@@ -69,3 +51,21 @@ StateDetail GetState(
 MultiState GetStateAllNextPieces(
     const Board& board, int now_piece, const Position& premove,
     int lines, TapSpeed tap_speed, int adj_delay, int aggression_level);
+
+// the same with any increasing tap table (frame of each tap) instead of a
+//   TapSpeed; an invalid table is treated like a game over
+StateDetail GetStateWithTaps(
+    const Board& board, int now_piece, int next_piece, const Position& premove,
+    int lines, const std::array<int, 10>& taps, int adj_delay, int aggression_level);
+
+MultiState GetStateAllNextPiecesWithTaps(
+    const Board& board, int now_piece, const Position& premove,
+    int lines, const std::array<int, 10>& taps, int adj_delay, int aggression_level);
+
+// premove == Position::Invalid to check a placement without adjustment
+PlacementCheck IsReachable(
+    const Board& board, int piece, const Position& target, const Position& premove,
+    int lines, TapSpeed tap_speed, int adj_delay);
+PlacementCheck IsReachableWithTaps(
+    const Board& board, int piece, const Position& target, const Position& premove,
+    int lines, const std::array<int, 10>& taps, int adj_delay);
@@ -1,9 +1,14 @@
 #!/bin/bash
-emcc -O2 -std=c++20 -fexceptions -sALLOW_MEMORY_GROWTH -sWASM_BIGINT -sENVIRONMENT=web -sEXPORT_ES6 \
+emcc -O2 -std=c++20 -fconstexpr-steps=33554432 -fexceptions -sALLOW_MEMORY_GROWTH -sWASM_BIGINT -sENVIRONMENT=web -sEXPORT_ES6 \
     -o tetris.js --emit-tsd tetris.d.ts --emit-symbol-map \
     tetris.cpp binding/*.cpp tetris/frame_sequence.cpp -lembind
 
-# emcc -O2 -std=c++20 -fexceptions -sALLOW_MEMORY_GROWTH -sWASM_BIGINT -sENVIRONMENT=web -sSINGLE_FILE \
+# same module with SIMD128 enabled; src/tetris.ts loads it when the browser supports SIMD
+emcc -O2 -std=c++20 -fconstexpr-steps=33554432 -msimd128 -fexceptions -sALLOW_MEMORY_GROWTH -sWASM_BIGINT -sENVIRONMENT=web -sEXPORT_ES6 \
+    -o tetris-simd.js --emit-tsd tetris-simd.d.ts --emit-symbol-map \
+    tetris.cpp binding/*.cpp tetris/frame_sequence.cpp -lembind
+
+# emcc -O2 -std=c++20 -fconstexpr-steps=33554432 -fexceptions -sALLOW_MEMORY_GROWTH -sWASM_BIGINT -sENVIRONMENT=web -sSINGLE_FILE \
 #     -o tetris-single.js \
 #     tetris.cpp binding/*.cpp tetris/frame_sequence.cpp -lembind
 
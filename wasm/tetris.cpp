@@ -21,7 +21,19 @@ EMSCRIPTEN_BINDINGS(my_module) {
     .function("isCellFilled", &Board::IsCellFilled)
     .function("placementNotation", &Board::PlacementNotation)
     .function("toBytes", &Board::ToByteVector)
-    .function("toString", &Board::ToString);
+    .function("toString", &Board::ToString)
+    .function("features", emscripten::select_overload<BoardFeatures(const Board&)>(&GetBoardFeatures));
+
+  DeclareArray<decltype(BoardFeatures::column_heights)>("BoardFeatures_column");
+  emscripten::value_object<BoardFeatures>("BoardFeatures")
+    .field("column_heights", &BoardFeatures::column_heights)
+    .field("holes", &BoardFeatures::holes)
+    .field("covered_cells", &BoardFeatures::covered_cells)
+    .field("well_depths", &BoardFeatures::well_depths)
+    .field("row_transitions", &BoardFeatures::row_transitions)
+    .field("column_transitions", &BoardFeatures::column_transitions)
+    .field("bumpiness", &BoardFeatures::bumpiness)
+    ;
 
   // state
   DeclareArray<ByteBoard>("ByteBoard");
@@ -71,6 +83,19 @@ EMSCRIPTEN_BINDINGS(my_module) {
 
   emscripten::function("GetState", &GetState);
   emscripten::function("GetStateAllNextPieces", &GetStateAllNextPieces);
+  // with a custom tap table instead of TapSpeed
+  DeclareArray<std::array<int, 10>>("TapTable");
+  emscripten::function("GetStateWithTaps", &GetStateWithTaps);
+  emscripten::function("GetStateAllNextPiecesWithTaps", &GetStateAllNextPiecesWithTaps);
+
+  emscripten::value_object<PlacementCheck>("PlacementCheck")
+    .field("reachable", &PlacementCheck::reachable)
+    .field("num_taps", &PlacementCheck::num_taps)
+    .field("tuck_type", &PlacementCheck::tuck_type)
+    ;
+  emscripten::function("IsReachable", emscripten::select_overload<PlacementCheck(
+      const Board&, int, const Position&, const Position&, int, TapSpeed, int)>(&IsReachable));
+  emscripten::function("IsReachableWithTaps", &IsReachableWithTaps);
 
   // frame sequence
   emscripten::value_object<AdjItem>("AdjItem")
@@ -79,4 +104,5 @@ EMSCRIPTEN_BINDINGS(my_module) {
     .field("frame_seq", &AdjItem::frame_seq)
     ;
   emscripten::function("GetBestAdjModes", &GetBestAdjModes);
+  emscripten::function("GetBestAdjModesWithTaps", &GetBestAdjModesWithTaps);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <tuple>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -24,7 +25,12 @@ constexpr int kBoardBytes = 25;
 //   column 1: bit 22-41
 //   column 2: bit 44-63
 // A bit of 1 means an empty cell; 0 otherwise.
+// When compiled with AVX2, shifts and bitwise operations act on all four
+// integers at once in a single ymm register; with wasm SIMD128 they act on
+// (b1, b2) and (b3, b4) as two 128-bit registers.
 class alignas(32) Board {
+  friend constexpr Board operator|(const Board& x, const Board& y);
+  friend constexpr Board operator&(const Board& x, const Board& y);
  private:
   // 1 wide, offset = (2, 0)
   static constexpr uint64_t kIPiece1_ = 0xf;
@@ -109,6 +115,27 @@ class alignas(32) Board {
     }
     return r;
   }
+#ifdef __AVX2__
+  // the four lanes are contiguous and 32-byte aligned, so they can be moved
+  // to and from a single ymm register
+  __m256i ToVec_() const {
+    return _mm256_load_si256(reinterpret_cast<const __m256i*>(&b1));
+  }
+  static Board FromVec_(__m256i v) {
+    Board r;
+    _mm256_store_si256(reinterpret_cast<__m256i*>(&r.b1), v);
+    return r;
+  }
+#elif defined(__wasm_simd128__)
+  v128_t Lo_() const { return wasm_v128_load(&b1); }
+  v128_t Hi_() const { return wasm_v128_load(&b3); }
+  static Board FromVec_(v128_t lo, v128_t hi) {
+    Board r;
+    wasm_v128_store(&r.b1, lo);
+    wasm_v128_store(&r.b3, hi);
+    return r;
+  }
+#endif
   constexpr Board PlaceI0_(int x, int y) const {
     Board r = *this;
     y -= 2;
@@ -145,28 +172,28 @@ class alignas(32) Board {
     constexpr uint64_t kColMask3 = 0x249249249249249L;
     constexpr uint64_t kColMask2 = 0x5555555555L;
     uint64_t cur = BytesToInt<uint64_t>(buf);
-    uint64_t r1 = pext(cur, kMask3); // 7,7,7
-    uint64_t r2 = pext(cur, kMask3 << 3); // 7,6,6
-    uint64_t r3 = pext(cur, kMask2 << 6); // 6
-    uint64_t r4 = pext(cur, kMask2 << 8); // 6
+    uint64_t r1 = pext<kMask3>(cur); // 7,7,7
+    uint64_t r2 = pext<(kMask3 << 3)>(cur); // 7,6,6
+    uint64_t r3 = pext<(kMask2 << 6)>(cur); // 6
+    uint64_t r4 = pext<(kMask2 << 8)>(cur); // 6
     cur = BytesToInt<uint64_t>(buf + 8);
-    r1 |= pext(cur, kMask3 << 6) << 21; // 6,6,6
-    r2 |= pext(cur, kMask3 >> 1) << 19; // 6,7,7
-    r3 |= pext(cur, kMask2 << 2) << 12; // 7
-    r4 |= pext(cur, kMask2 << 4) << 12; // 6
+    r1 |= pext<(kMask3 << 6)>(cur) << 21; // 6,6,6
+    r2 |= pext<(kMask3 >> 1)>(cur) << 19; // 6,7,7
+    r3 |= pext<(kMask2 << 2)>(cur) << 12; // 7
+    r4 |= pext<(kMask2 << 4)>(cur) << 12; // 6
     cur = BytesToInt<uint64_t>(buf + 16);
-    r1 |= pext(cur, kMask3 << 2) << 39; // 7,7,6
-    r2 |= pext(cur, kMask3 << 5) << 39; // 6,6,6
-    r3 |= pext(cur, kMask2 << 8) << 26; // 6
-    r4 |= pext(cur, kMask2) << 24; // 7
+    r1 |= pext<(kMask3 << 2)>(cur) << 39; // 7,7,6
+    r2 |= pext<(kMask3 << 5)>(cur) << 39; // 6,6,6
+    r3 |= pext<(kMask2 << 8)>(cur) << 26; // 6
+    r4 |= pext<kMask2>(cur) << 24; // 7
     r1 |= (uint64_t)(buf[24] & 0x1) << 59;
     r2 |= (uint64_t)(buf[24] & 0xe) << (57 - 1);
     r3 |= (uint64_t)(buf[24] & 0x30) << (38 - 4);
     r4 |= (uint64_t)(buf[24] & 0xc0) << (38 - 6);
-    b1 = pext(r1, kColMask3) | pext(r1, kColMask3 << 1) << 22 | pext(r1, kColMask3 << 2) << 44;
-    b2 = pext(r2, kColMask3) | pext(r2, kColMask3 << 1) << 22 | pext(r2, kColMask3 << 2) << 44;
-    b3 = pext(r3, kColMask2) | pext(r3, kColMask2 << 1) << 22 | pext(r4, kColMask2) << 44;
-    b4 = pext(r4, kColMask2 << 1);
+    b1 = pext<kColMask3>(r1) | pext<(kColMask3 << 1)>(r1) << 22 | pext<(kColMask3 << 2)>(r1) << 44;
+    b2 = pext<kColMask3>(r2) | pext<(kColMask3 << 1)>(r2) << 22 | pext<(kColMask3 << 2)>(r2) << 44;
+    b3 = pext<kColMask2>(r3) | pext<(kColMask2 << 1)>(r3) << 22 | pext<kColMask2>(r4) << 44;
+    b4 = pext<(kColMask2 << 1)>(r4);
   }
 
   constexpr Board(const ByteBoard& board) : b1(), b2(), b3(), b4() {
@@ -214,10 +241,11 @@ class alignas(32) Board {
     unreachable();
   }
 
+  template <PextMode mode = kDefaultPextMode>
   constexpr uint32_t Row(int r) const {
     constexpr uint64_t kRowMask = 0x100000400001;
-    return pext(b1 >> r, kRowMask) | pext(b2 >> r, kRowMask) << 3 |
-        pext(b3 >> r, kRowMask) << 6 | pext(b4 >> r, kRowMask) << 9;
+    return pext<kRowMask, mode>(b1 >> r) | pext<kRowMask, mode>(b2 >> r) << 3 |
+        pext<kRowMask, mode>(b3 >> r) << 6 | pext<kRowMask, mode>(b4 >> r) << 9;
   }
 
   constexpr std::array<uint32_t, 10> Columns() const {
@@ -226,9 +254,28 @@ class alignas(32) Board {
     return arr;
   }
 
+  // With hardware pext, 80 pexts are the fastest. Otherwise transpose 8x8
+  //   blocks, which is several times cheaper than the emulated pexts.
+  template <PextMode mode = kDefaultPextMode>
   constexpr std::array<uint32_t, 20> Rows() const {
-    std::array<uint32_t, 20> arr;
-    for (int i = 0; i < 20; i++) arr[i] = Row(i);
+    std::array<uint32_t, 20> arr{};
+    if (mode == PextMode::kHardware && !std::is_constant_evaluated()) {
+      for (int i = 0; i < 20; i++) arr[i] = Row<mode>(i);
+      return arr;
+    }
+    for (int g = 0; g < 3; g++) {
+      uint64_t w1 = b1 >> (g * 8), w2 = b2 >> (g * 8), w3 = b3 >> (g * 8), w4 = b4 >> (g * 8);
+      // one byte per column; columns 0-7 in lo, 8-9 in hi
+      uint64_t lo = (w1 & 0xff) | (w1 >> 14 & 0xff00) | (w1 >> 28 & 0xff0000) |
+          (w2 & 0xff) << 24 | (w2 >> 22 & 0xff) << 32 | (w2 >> 44 & 0xff) << 40 |
+          (w3 & 0xff) << 48 | (w3 >> 22 & 0xff) << 56;
+      uint64_t hi = (w3 >> 44 & 0xff) | (w4 & 0xff) << 8;
+      lo = Transpose8x8(lo);
+      hi = Transpose8x8(hi);
+      for (int r = 0; r < 8 && g * 8 + r < 20; r++) {
+        arr[g * 8 + r] = (lo >> (r * 8) & 0xff) | (hi >> (r * 8) & 0x3) << 8;
+      }
+    }
     return arr;
   }
 
@@ -241,27 +288,27 @@ class alignas(32) Board {
     constexpr uint64_t kMask2 = 0x300C0300C0300C03L;
     constexpr uint64_t kColMask3 = 0x249249249249249L;
     constexpr uint64_t kColMask2 = 0x5555555555L;
-    uint64_t r1 = pdep(b1, kColMask3) | pdep(b1 >> 22, kColMask3 << 1) | pdep(b1 >> 44, kColMask3 << 2);
-    uint64_t r2 = pdep(b2, kColMask3) | pdep(b2 >> 22, kColMask3 << 1) | pdep(b2 >> 44, kColMask3 << 2);
-    uint64_t r3 = pdep(b3, kColMask2) | pdep(b3 >> 22, kColMask2 << 1);
-    uint64_t r4 = pdep(b3 >> 44, kColMask2) | pdep(b4, kColMask2 << 1);
+    uint64_t r1 = pdep<kColMask3>(b1) | pdep<(kColMask3 << 1)>(b1 >> 22) | pdep<(kColMask3 << 2)>(b1 >> 44);
+    uint64_t r2 = pdep<kColMask3>(b2) | pdep<(kColMask3 << 1)>(b2 >> 22) | pdep<(kColMask3 << 2)>(b2 >> 44);
+    uint64_t r3 = pdep<kColMask2>(b3) | pdep<(kColMask2 << 1)>(b3 >> 22);
+    uint64_t r4 = pdep<kColMask2>(b3 >> 44) | pdep<(kColMask2 << 1)>(b4);
     buf[24] = (r1 >> 59 & 0x1) | (r2 >> (57 - 1) & 0xe) |
               (r3 >> (38 - 4) & 0x30) | (r4 >> (38 - 6) & 0xc0);
     uint64_t cur = 0;
-    cur  = pdep(r1 >> 39, kMask3 << 2);
-    cur |= pdep(r2 >> 39, kMask3 << 5);
-    cur |= pdep(r3 >> 26, kMask2 << 8);
-    cur |= pdep(r4 >> 24, kMask2);
+    cur  = pdep<(kMask3 << 2)>(r1 >> 39);
+    cur |= pdep<(kMask3 << 5)>(r2 >> 39);
+    cur |= pdep<(kMask2 << 8)>(r3 >> 26);
+    cur |= pdep<kMask2>(r4 >> 24);
     IntToBytes<uint64_t>(cur, buf + 16);
-    cur  = pdep(r1 >> 21, kMask3 << 6);
-    cur |= pdep(r2 >> 19, kMask3 >> 1);
-    cur |= pdep(r3 >> 12, kMask2 << 2);
-    cur |= pdep(r4 >> 12, kMask2 << 4);
+    cur  = pdep<(kMask3 << 6)>(r1 >> 21);
+    cur |= pdep<(kMask3 >> 1)>(r2 >> 19);
+    cur |= pdep<(kMask2 << 2)>(r3 >> 12);
+    cur |= pdep<(kMask2 << 4)>(r4 >> 12);
     IntToBytes<uint64_t>(cur, buf + 8);
-    cur  = pdep(r1, kMask3);
-    cur |= pdep(r2, kMask3 << 3);
-    cur |= pdep(r3, kMask2 << 6);
-    cur |= pdep(r4, kMask2 << 8);
+    cur  = pdep<kMask3>(r1);
+    cur |= pdep<(kMask3 << 3)>(r2);
+    cur |= pdep<(kMask2 << 6)>(r3);
+    cur |= pdep<(kMask2 << 8)>(r4);
     IntToBytes<uint64_t>(cur, buf);
   }
 
@@ -273,9 +320,12 @@ class alignas(32) Board {
 
   constexpr ByteBoard ToByteBoard() const {
     ByteBoard b{};
-    for (int i = 0; i < 10; i++) {
-      uint32_t col = Column(i);
-      for (int j = 0; j < 20; j++) b[j][i] = col >> j & 1;
+    std::array<uint32_t, 20> rows = Rows();
+    for (int i = 0; i < 20; i++) {
+      // one byte per cell
+      IntToBytes<uint64_t>(pdep<(uint64_t)0x0101010101010101>(rows[i]), b[i].data());
+      b[i][8] = rows[i] >> 8 & 1;
+      b[i][9] = rows[i] >> 9 & 1;
     }
     return b;
   }
@@ -327,11 +377,12 @@ class alignas(32) Board {
     }
   }
 
+  template <PextMode mode = kDefaultPextMode>
   constexpr std::pair<int, Board> ClearLines(uint32_t* clear_mask = nullptr) const {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnarrowing"
     // use an order in favor of vectorization
-    // pext will clear unnecessary bits
+    // pext (or the masking below) will clear unnecessary bits
     uint32_t cols[] = {
         b1, b2, b3, b4,
         b1 >> 22, b2 >> 22, b3 >> 22, 0,
@@ -342,8 +393,20 @@ class alignas(32) Board {
     if (clear_mask) *clear_mask = ~linemask & kColumnMask;
     if (linemask == kColumnMask) return {0, *this};
     int lines = 20 - popcount(linemask);
-    for (int i = 0; i < 11; i++) {
-      cols[i] = pext(cols[i], linemask) << lines | ((1 << lines) - 1);
+    if (mode == PextMode::kHardware && !std::is_constant_evaluated()) {
+      for (int i = 0; i < 11; i++) {
+        cols[i] = pext<uint32_t, mode>(cols[i], linemask) << lines | ((1 << lines) - 1);
+      }
+    } else {
+      // the mask is not a constant here, so without hardware pext it is cheaper
+      // to remove the (few) full rows one at a time, topmost first
+      for (uint32_t full = ~linemask & kColumnMask; full; full &= full - 1) {
+        uint32_t above = (full & -full) - 1;
+        for (int i = 0; i < 11; i++) {
+          cols[i] = (cols[i] & ~(above << 1 | 1)) | (cols[i] & above) << 1 | 1;
+        }
+      }
+      for (int i = 0; i < 11; i++) cols[i] &= kColumnMask;
     }
     return {lines, {
         cols[0] | (uint64_t)cols[4] << 22 | (uint64_t)cols[8] << 44,
@@ -353,9 +416,9 @@ class alignas(32) Board {
   }
 
   constexpr int NumFullLines() const {
-    uint32_t clear_mask;
-    ClearLines(&clear_mask);
-    return popcount(clear_mask);
+    // a row is full if no column has an empty cell there
+    uint64_t p = b1 | b2 | b3;
+    return 20 - popcount<uint32_t>((p | p >> 22 | p >> 44 | b4) & kColumnMask);
   }
 
   constexpr std::vector<int> ClearLinesInplace() {
@@ -373,24 +436,89 @@ class alignas(32) Board {
 
   // x = 1 or 2 for these 4 methods
   constexpr Board ShiftLeft(int x) const {
+#ifdef __AVX2__
+    if (!std::is_constant_evaluated()) {
+      // lane i takes the low columns of lane i+1; b4 is always shifted out
+      __m256i v = ToVec_();
+      __m256i next = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 3, 2, 1));
+      __m256i r = _mm256_or_si256(
+          _mm256_srl_epi64(v, _mm_cvtsi32_si128(x * 22)),
+          _mm256_sll_epi64(next, _mm_cvtsi32_si128(66 - x * 22)));
+      return FromVec_(_mm256_blend_epi32(r, _mm256_setzero_si256(), 0xc0));
+    }
+#elif defined(__wasm_simd128__)
+    if (!std::is_constant_evaluated()) {
+      v128_t lo = Lo_(), hi = Hi_();
+      v128_t next_lo = wasm_i64x2_shuffle(lo, hi, 1, 2);
+      v128_t next_hi = wasm_i64x2_shuffle(hi, wasm_i64x2_const(0, 0), 1, 2);
+      lo = wasm_v128_or(wasm_u64x2_shr(lo, x * 22), wasm_i64x2_shl(next_lo, 66 - x * 22));
+      hi = wasm_v128_or(wasm_u64x2_shr(hi, x * 22), wasm_i64x2_shl(next_hi, 66 - x * 22));
+      return FromVec_(lo, wasm_v128_and(hi, wasm_i64x2_const(-1, 0)));
+    }
+#endif
     return {b1 >> (x * 22) | b2 << (66 - x * 22),
             b2 >> (x * 22) | b3 << (66 - x * 22),
             b3 >> (x * 22) | b4 << (66 - x * 22),
             0};
   }
   constexpr Board ShiftRight(int x) const {
+#ifdef __AVX2__
+    if (!std::is_constant_evaluated()) {
+      // lane i takes the high columns of lane i-1; b4 only receives from b3
+      __m256i v = ToVec_();
+      __m256i prev = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 1, 0, 0));
+      __m256i hi = _mm256_blend_epi32(
+          _mm256_sll_epi64(v, _mm_cvtsi32_si128(x * 22)), _mm256_setzero_si256(), 0xc0);
+      __m256i lo = _mm256_and_si256(
+          _mm256_srl_epi64(prev, _mm_cvtsi32_si128(66 - x * 22)),
+          _mm256_setr_epi64x(0, -1, -1, kColumnMask));
+      return FromVec_(_mm256_or_si256(hi, lo));
+    }
+#elif defined(__wasm_simd128__)
+    if (!std::is_constant_evaluated()) {
+      v128_t lo = Lo_(), hi = Hi_();
+      v128_t prev_lo = wasm_i64x2_shuffle(wasm_i64x2_const(0, 0), lo, 0, 2);
+      v128_t prev_hi = wasm_i64x2_shuffle(lo, hi, 1, 2);
+      lo = wasm_v128_or(wasm_i64x2_shl(lo, x * 22), wasm_u64x2_shr(prev_lo, 66 - x * 22));
+      hi = wasm_v128_or(
+          wasm_v128_and(wasm_i64x2_shl(hi, x * 22), wasm_i64x2_const(-1, 0)),
+          wasm_v128_and(wasm_u64x2_shr(prev_hi, 66 - x * 22), wasm_i64x2_const(-1, kColumnMask)));
+      return FromVec_(lo, hi);
+    }
+#endif
     return {b1 << (x * 22),
             b2 << (x * 22) | b1 >> (66 - x * 22),
             b3 << (x * 22) | b2 >> (66 - x * 22),
             b3 >> (66 - x * 22) & kColumnMask};
   }
   constexpr Board ShiftUpNoFilter(int x) const {
+#ifdef __AVX2__
+    if (!std::is_constant_evaluated()) {
+      return FromVec_(_mm256_srl_epi64(ToVec_(), _mm_cvtsi32_si128(x)));
+    }
+#elif defined(__wasm_simd128__)
+    if (!std::is_constant_evaluated()) {
+      return FromVec_(wasm_u64x2_shr(Lo_(), x), wasm_u64x2_shr(Hi_(), x));
+    }
+#endif
     return {b1 >> x, b2 >> x, b3 >> x, b4 >> x};
   }
   constexpr Board ShiftDownNoFilter(int x) const {
     constexpr uint64_t kDownPadding = 0x100000400001;
     uint64_t padding = kDownPadding;
     if (x == 2) padding |= padding << 1;
+#ifdef __AVX2__
+    if (!std::is_constant_evaluated()) {
+      return FromVec_(_mm256_or_si256(
+          _mm256_sll_epi64(ToVec_(), _mm_cvtsi32_si128(x)), _mm256_set1_epi64x(padding)));
+    }
+#elif defined(__wasm_simd128__)
+    if (!std::is_constant_evaluated()) {
+      v128_t pad = wasm_i64x2_splat(padding);
+      return FromVec_(
+          wasm_v128_or(wasm_i64x2_shl(Lo_(), x), pad), wasm_v128_or(wasm_i64x2_shl(Hi_(), x), pad));
+    }
+#endif
     return {b1 << x | padding, b2 << x | padding, b3 << x | padding, b4 << x | padding};
   }
 
@@ -520,6 +648,40 @@ class alignas(32) Board {
     unreachable();
   }
 
+  // PieceMap<piece>() of all pieces; get one with std::get<piece>
+  using AllPieceMaps = std::tuple<
+      std::array<Board, 4>, std::array<Board, 4>, std::array<Board, 2>, std::array<Board, 1>,
+      std::array<Board, 2>, std::array<Board, 4>, std::array<Board, 2>>;
+
+  // same as calling PieceMap for each piece, but every shifted board is
+  //   computed only once
+  constexpr AllPieceMaps GetAllPieceMaps() const {
+    Board u = ShiftUpNoFilter(1);
+    Board d = ShiftDownNoFilter(1);
+    Board d2 = ShiftDownNoFilter(2);
+    Board l = ShiftLeft(1);
+    Board r = ShiftRight(1);
+    Board r2 = ShiftRight(2);
+    Board ul = u.ShiftLeft(1);
+    Board ur = u.ShiftRight(1);
+    // ZMap uses l.ShiftDownNoFilter(1), which differs only in cell (0, 9);
+    //   l is 0 there, so the results are the same
+    Board dl = d.ShiftLeft(1);
+    Board dr = d.ShiftRight(1);
+    Board lr = l & r & *this;
+    Board ud = u & d & *this;
+    Board u_self = u & *this;
+    return {
+      {{u & lr, ud & r, d & lr, ud & l}}, // T
+      {{ul & lr, ur & ud, dr & lr, dl & ud}}, // J
+      {{u_self & r & ul, u_self & l & dl}}, // Z
+      {{u_self & r & ur}}, // O
+      {{u_self & l & ur, d & l & ul & *this}}, // S
+      {{ur & lr, dr & ud, dl & lr, ul & ud}}, // L
+      {{lr & r2, ud & d2}}, // I
+    };
+  }
+
   template <int piece> constexpr Board PieceMapNoro() const {
     if constexpr (piece == 0) return TMap()[0];
     if constexpr (piece == 1) return JMap()[0];
@@ -626,10 +788,28 @@ class alignas(32) Board {
   constexpr bool operator==(const Board& x) const = default;
   constexpr bool operator!=(const Board& x) const = default;
   constexpr Board& operator|=(const Board& x) {
+#ifdef __AVX2__
+    if (!std::is_constant_evaluated()) {
+      return *this = FromVec_(_mm256_or_si256(ToVec_(), x.ToVec_()));
+    }
+#elif defined(__wasm_simd128__)
+    if (!std::is_constant_evaluated()) {
+      return *this = FromVec_(wasm_v128_or(Lo_(), x.Lo_()), wasm_v128_or(Hi_(), x.Hi_()));
+    }
+#endif
     b1 |= x.b1; b2 |= x.b2; b3 |= x.b3; b4 |= x.b4;
     return *this;
   }
   constexpr Board& operator&=(const Board& x) {
+#ifdef __AVX2__
+    if (!std::is_constant_evaluated()) {
+      return *this = FromVec_(_mm256_and_si256(ToVec_(), x.ToVec_()));
+    }
+#elif defined(__wasm_simd128__)
+    if (!std::is_constant_evaluated()) {
+      return *this = FromVec_(wasm_v128_and(Lo_(), x.Lo_()), wasm_v128_and(Hi_(), x.Hi_()));
+    }
+#endif
     b1 &= x.b1; b2 &= x.b2; b3 &= x.b3; b4 &= x.b4;
     return *this;
   }
@@ -649,14 +829,14 @@ class alignas(32) Board {
     if (!compact) first_row = 0;
 
     std::string ret;
-    auto b = obj.ToByteBoard();
+    auto b = obj.Rows();
     for (int row = first_row; row < 20; row++) {
       if (row_numbers) {
         std::string str = std::to_string(row);
         if (str.size() == 1) str = ' ' + str;
         ret += str + ' ';
       }
-      for (auto i : b[row]) ret += "X."[i];
+      for (int i = 0; i < 10; i++) ret += "X."[b[row] >> i & 1];
       ret += '\n';
     }
     return ret;
@@ -697,8 +877,26 @@ inline constexpr Board Board::Zeros = Board(0, 0, 0, 0);
 inline constexpr Board Board::Ones = ~Board(0, 0, 0, 0);
 
 constexpr Board operator|(const Board& x, const Board& y) {
+#ifdef __AVX2__
+  if (!std::is_constant_evaluated()) {
+    return Board::FromVec_(_mm256_or_si256(x.ToVec_(), y.ToVec_()));
+  }
+#elif defined(__wasm_simd128__)
+  if (!std::is_constant_evaluated()) {
+    return Board::FromVec_(wasm_v128_or(x.Lo_(), y.Lo_()), wasm_v128_or(x.Hi_(), y.Hi_()));
+  }
+#endif
   return {x.b1 | y.b1, x.b2 | y.b2, x.b3 | y.b3, x.b4 | y.b4};
 }
 constexpr Board operator&(const Board& x, const Board& y) {
+#ifdef __AVX2__
+  if (!std::is_constant_evaluated()) {
+    return Board::FromVec_(_mm256_and_si256(x.ToVec_(), y.ToVec_()));
+  }
+#elif defined(__wasm_simd128__)
+  if (!std::is_constant_evaluated()) {
+    return Board::FromVec_(wasm_v128_and(x.Lo_(), y.Lo_()), wasm_v128_and(x.Hi_(), y.Hi_()));
+  }
+#endif
   return {x.b1 & y.b1, x.b2 & y.b2, x.b3 & y.b3, x.b4 & y.b4};
 }
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "board.h"
+
+// Many boards stored as structure-of-arrays (one array per Board integer), so
+//   that each batched method below is a branch-free loop over boards that the
+//   compiler can vectorise (4 boards per AVX2 op, 2 per SIMD128 op).
+// Results match calling the same method on each Board.
+class BoardBatch {
+  struct Cell {
+    int8_t row, col;
+  };
+  using PieceCells = std::array<Cell, 4>;
+
+  // cells covered by each (piece, rotation), relative to the position passed to
+  //   Board::Place; derived from Board::Place itself so they always agree
+  static constexpr std::array<std::array<PieceCells, 4>, kPieces> kPieceCells_ = []() {
+    constexpr int kX = 10, kY = 5;
+    std::array<std::array<PieceCells, 4>, kPieces> ret{};
+    for (int piece = 0; piece < (int)kPieces; piece++) {
+      for (int r = 0; r < Board::NumRotations(piece); r++) {
+        Board b = Board::Ones.Place(piece, r, kX, kY);
+        int n = 0;
+        for (int row = 0; row < 20; row++) {
+          for (int col = 0; col < 10; col++) {
+            if (b.IsCellFilled(row, col)) ret[piece][r][n++] = {int8_t(row - kX), int8_t(col - kY)};
+          }
+        }
+      }
+    }
+    return ret;
+  }();
+
+ public:
+  std::vector<uint64_t> b1, b2, b3, b4;
+
+  BoardBatch() = default;
+  explicit BoardBatch(size_t n, const Board& board = Board::Ones) :
+      b1(n, board.b1), b2(n, board.b2), b3(n, board.b3), b4(n, board.b4) {}
+
+  size_t size() const { return b1.size(); }
+
+  void resize(size_t n, const Board& board = Board::Ones) {
+    b1.resize(n, board.b1);
+    b2.resize(n, board.b2);
+    b3.resize(n, board.b3);
+    b4.resize(n, board.b4);
+  }
+
+  Board Get(size_t i) const { return {b1[i], b2[i], b3[i], b4[i]}; }
+  void Set(size_t i, const Board& board) {
+    b1[i] = board.b1;
+    b2[i] = board.b2;
+    b3[i] = board.b3;
+    b4[i] = board.b4;
+  }
+
+  // same as b.PlaceInplace(piece[i], r[i], x[i], y[i]) for each board
+  void Place(const int piece[], const int r[], const int x[], const int y[]) {
+    size_t n = size();
+    for (size_t i = 0; i < n; i++) {
+      const PieceCells& cells = kPieceCells_[piece[i]][r[i]];
+      uint64_t m1 = 0, m2 = 0, m3 = 0, m4 = 0;
+      for (int c = 0; c < 4; c++) {
+        int row = x[i] + cells[c].row, col = y[i] + cells[c].col;
+        int lane = col / 3; // column 9 is lane 3 at offset 0
+        // cells above the board are dropped, as in Board::Place
+        uint64_t bit = (uint64_t)(row >= 0) << (std::max(row, 0) + (col - lane * 3) * 22);
+        m1 |= lane == 0 ? bit : 0;
+        m2 |= lane == 1 ? bit : 0;
+        m3 |= lane == 2 ? bit : 0;
+        m4 |= lane == 3 ? bit : 0;
+      }
+      b1[i] &= ~m1;
+      b2[i] &= ~m2;
+      b3[i] &= ~m3;
+      b4[i] &= ~m4;
+    }
+  }
+
+  // same as b = b.ClearLines().second for each board; lines[i] receives the number of cleared lines
+  void ClearLines(int lines[]) {
+    size_t n = size();
+    for (size_t i = 0; i < n; i++) lines[i] = FullRows_(i);
+    // remove full rows from top to bottom; removing a row only moves the rows
+    //   above it, so the row masks computed beforehand stay valid
+    for (int row = 0; row < 20; row++) {
+      constexpr uint64_t kTop = 0x100000400001;
+      uint64_t above = kTop * ((1ull << row) - 1);
+      uint64_t keep = Board::kBoardMask & ~(above << 1 | kTop);
+      for (size_t i = 0; i < n; i++) {
+        uint64_t sel = -(uint64_t)(lines[i] >> row & 1);
+        b1[i] = (b1[i] & ~sel) | (((b1[i] & keep) | (b1[i] & above) << 1 | kTop) & sel);
+        b2[i] = (b2[i] & ~sel) | (((b2[i] & keep) | (b2[i] & above) << 1 | kTop) & sel);
+        b3[i] = (b3[i] & ~sel) | (((b3[i] & keep) | (b3[i] & above) << 1 | kTop) & sel);
+        b4[i] = (b4[i] & ~sel) | (((b4[i] & keep) | (b4[i] & above) << 1 | 1) & sel & Board::kColumnMask);
+      }
+    }
+    for (size_t i = 0; i < n; i++) lines[i] = popcount<uint32_t>(lines[i]);
+  }
+
+  void Count(int ret[]) const {
+    size_t n = size();
+    for (size_t i = 0; i < n; i++) {
+      ret[i] = 200 - (popcount(b1[i]) + popcount(b2[i]) + popcount(b3[i]) + popcount(b4[i]));
+    }
+  }
+
+  void Height(int ret[]) const {
+    size_t n = size();
+    for (size_t i = 0; i < n; i++) {
+      uint64_t p = b1[i] & b2[i] & b3[i];
+      uint32_t col_and = p & p >> 22 & p >> 44 & b4[i];
+      ret[i] = 20 - ctz(~col_and);
+    }
+  }
+
+  void NumFullLines(int ret[]) const {
+    size_t n = size();
+    for (size_t i = 0; i < n; i++) ret[i] = popcount(FullRows_(i));
+  }
+
+ private:
+  // bitmask of full rows (a set bit is an empty cell, so a row is full when no column has it set)
+  uint32_t FullRows_(size_t i) const {
+    uint64_t p = b1[i] | b2[i] | b3[i];
+    return ~(p | p >> 22 | p >> 44 | b4[i]) & Board::kColumnMask;
+  }
+};
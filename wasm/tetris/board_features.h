@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cstdlib>
+
+#include "board.h"
+#include "board_batch.h"
+
+// Surface features of a board, for heuristics and statistics.
+// All of them are computed on whole 20-bit columns (bit 0 = top row), so
+//   nothing loops over cells.
+struct BoardFeatures {
+  std::array<int, 10> column_heights;
+  // number of empty cells below the top filled cell of their column
+  int holes;
+  // number of filled cells above the lowest hole of their column
+  int covered_cells;
+  // how far each column is below the lower of its two neighbours (walls count as height 20)
+  std::array<int, 10> well_depths;
+  // number of horizontally adjacent filled/empty pairs in the rows up to the
+  //   stack height, with the walls counting as filled
+  int row_transitions;
+  // number of vertically adjacent filled/empty pairs, with the floor counting as filled
+  int column_transitions;
+  // sum of height differences between adjacent columns
+  int bumpiness;
+
+  constexpr bool operator==(const BoardFeatures& x) const = default;
+};
+
+constexpr BoardFeatures GetBoardFeatures(const Board& b) {
+  constexpr uint32_t kColumnMask = Board::kColumnMask;
+  BoardFeatures ret{};
+  std::array<uint32_t, 10> cols = b.Columns();
+  for (int c = 0; c < 10; c++) {
+    uint32_t filled = ~cols[c] & kColumnMask;
+    uint32_t top = filled & -filled; // 0 if the column is empty
+    uint32_t hole_mask = cols[c] & -top & kColumnMask;
+    // bits above the lowest hole
+    uint32_t above_hole = hole_mask ? (1u << (31 - clz(hole_mask))) - 1 : 0;
+    ret.column_heights[c] = filled ? 20 - ctz(filled) : 0;
+    ret.holes += popcount(hole_mask);
+    ret.covered_cells += popcount(filled & above_hole);
+    ret.column_transitions += popcount((cols[c] ^ cols[c] >> 1) & kColumnMask >> 1) + (cols[c] >> 19);
+  }
+  const auto& h = ret.column_heights;
+  for (int c = 0; c < 10; c++) {
+    int left = c == 0 ? 20 : h[c - 1], right = c == 9 ? 20 : h[c + 1];
+    ret.well_depths[c] = std::max(std::min(left, right) - h[c], 0);
+  }
+  for (int c = 0; c < 9; c++) ret.bumpiness += std::abs(h[c] - h[c + 1]);
+
+  uint32_t stack_rows = kColumnMask & ~((1u << (20 - b.Height())) - 1);
+  ret.row_transitions = popcount(cols[0] & stack_rows) + popcount(cols[9] & stack_rows);
+  for (int c = 0; c < 9; c++) ret.row_transitions += popcount((cols[c] ^ cols[c + 1]) & stack_rows);
+  return ret;
+}
+
+inline void GetBoardFeatures(const BoardBatch& batch, BoardFeatures ret[]) {
+  size_t n = batch.size();
+  for (size_t i = 0; i < n; i++) ret[i] = GetBoardFeatures(batch.Get(i));
+}
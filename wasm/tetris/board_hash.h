@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "board.h"
+#include "hash.h"
+
+// Hash of a board that can be updated as pieces are placed and lines cleared.
+// The raw value is linear in the columns: the sum of kKeys_[c] * Column(c)
+//   modulo 2^64, with random odd keys. Each empty cell (row, c) thus adds
+//   kKeys_[c] << row, so placing a piece subtracts four cell keys, and clearing
+//   lines adds a term per cleared line for the part of the board above it.
+// Value() mixes the raw value; std::hash<Board> returns the same thing.
+class BoardHash {
+  static constexpr std::array<uint64_t, 10> kKeys_ = []() {
+    std::array<uint64_t, 10> ret{};
+    for (int c = 0; c < 10; c++) ret[c] = Hash(0x626f617264, c) | 1;
+    return ret;
+  }();
+  static constexpr uint64_t kKeySum_ = []() {
+    uint64_t ret = 0;
+    for (auto i : kKeys_) ret += i;
+    return ret;
+  }();
+  // key of each bit of b1..b4 (0 for the bits between columns)
+  static constexpr std::array<std::array<uint64_t, 64>, 4> kBitKeys_ = []() {
+    std::array<std::array<uint64_t, 64>, 4> ret{};
+    for (int c = 0; c < 10; c++) {
+      for (int row = 0; row < 20; row++) ret[c / 3][c % 3 * 22 + row] = kKeys_[c] << row;
+    }
+    return ret;
+  }();
+
+  static constexpr uint64_t BitKeySum_(int lane, uint64_t bits) {
+    uint64_t ret = 0;
+    for (; bits; bits &= bits - 1) ret += kBitKeys_[lane][ctz(bits)];
+    return ret;
+  }
+
+  uint64_t raw_;
+
+ public:
+  constexpr BoardHash() : raw_() {}
+  explicit constexpr BoardHash(const Board& b) : raw_() {
+    std::array<uint32_t, 10> cols = b.Columns();
+    for (int c = 0; c < 10; c++) raw_ += kKeys_[c] * cols[c];
+  }
+
+  constexpr uint64_t Raw() const { return raw_; }
+  constexpr uint64_t Value() const { return Hash(raw_, 0); }
+
+  // after changing the board from `before` to `after` by setting or clearing a
+  //   few cells (e.g. Board::Place); the cost is proportional to the number of
+  //   changed cells
+  constexpr void Update(const Board& before, const Board& after) {
+    raw_ += BitKeySum_(0, after.b1 & ~before.b1) - BitKeySum_(0, before.b1 & ~after.b1);
+    raw_ += BitKeySum_(1, after.b2 & ~before.b2) - BitKeySum_(1, before.b2 & ~after.b2);
+    raw_ += BitKeySum_(2, after.b3 & ~before.b3) - BitKeySum_(2, before.b3 & ~after.b3);
+    raw_ += BitKeySum_(3, after.b4 & ~before.b4) - BitKeySum_(3, before.b4 & ~after.b4);
+  }
+
+  // after before.ClearLines(&clear_mask)
+  // Removing the k-th full row from the bottom moves the cells above it down by
+  //   k+1 rows in total and adds k+1 empty rows on top; each new empty row is
+  //   counted by the kKeySum_ term.
+  constexpr void ClearLines(const Board& before, uint32_t clear_mask) {
+    constexpr uint64_t kTop = 0x100000400001;
+    uint64_t s1 = 0, s2 = 0, s3 = 0, s4 = 0;
+    int lines = 0;
+    for (; clear_mask; lines++) {
+      int row = 31 - clz(clear_mask);
+      clear_mask ^= 1u << row;
+      uint64_t above = kTop * ((1ull << row) - 1);
+      // each column field stays below 2^21 (at most 4 terms below 2^19), so
+      //   the sums never carry into the next field
+      s1 += (before.b1 & above) << lines;
+      s2 += (before.b2 & above) << lines;
+      s3 += (before.b3 & above) << lines;
+      s4 += (before.b4 & above) << lines;
+    }
+    constexpr uint64_t kFieldMask = 0x3fffff;
+    for (int i = 0; i < 3; i++) {
+      raw_ += kKeys_[i] * (s1 >> (i * 22) & kFieldMask) +
+              kKeys_[i + 3] * (s2 >> (i * 22) & kFieldMask) +
+              kKeys_[i + 6] * (s3 >> (i * 22) & kFieldMask);
+    }
+    raw_ += kKeys_[9] * s4 + kKeySum_ * ((1ull << lines) - 1);
+  }
+
+  constexpr bool operator==(const BoardHash& x) const = default;
+};
+
+// A board together with its BoardHash, kept up to date by the same operations
+//   as Board.
+struct HashedBoard {
+  Board board;
+  BoardHash hash;
+
+  HashedBoard() = default;
+  explicit constexpr HashedBoard(const Board& board) : board(board), hash(board) {}
+
+  constexpr HashedBoard Place(int piece, int r, int x, int y) const {
+    HashedBoard ret = *this;
+    ret.PlaceInplace(piece, r, x, y);
+    return ret;
+  }
+  constexpr void PlaceInplace(int piece, int r, int x, int y) {
+    Board before = board;
+    board.PlaceInplace(piece, r, x, y);
+    hash.Update(before, board);
+  }
+
+  constexpr std::pair<int, HashedBoard> ClearLines(uint32_t* clear_mask = nullptr) const {
+    uint32_t mask;
+    auto [lines, new_board] = board.ClearLines(&mask);
+    HashedBoard ret = *this;
+    ret.board = new_board;
+    if (lines) ret.hash.ClearLines(board, mask);
+    if (clear_mask) *clear_mask = mask;
+    return {lines, ret};
+  }
+  constexpr std::vector<int> ClearLinesInplace() {
+    Board before = board;
+    uint32_t mask;
+    board = board.ClearLines(&mask).second;
+    if (mask) hash.ClearLines(before, mask);
+    std::vector<int> ret;
+    for (; mask; mask &= mask - 1) ret.push_back(ctz(mask));
+    return ret;
+  }
+
+  constexpr bool operator==(const HashedBoard& x) const { return board == x.board; }
+};
+
+namespace std {
+
+template<>
+struct hash<Board> {
+  constexpr size_t operator()(const Board& b) const {
+    return BoardHash(b).Value();
+  }
+};
+
+template<>
+struct hash<HashedBoard> {
+  constexpr size_t operator()(const HashedBoard& b) const {
+    return b.hash.Value();
+  }
+};
+
+} // namespace std
@@ -1,9 +1,17 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <utility>
 #include <memory>
 #include <type_traits>
 #include <immintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
 
 #ifdef _MSC_VER
 #define NOINLINE __declspec(noinline)
@@ -11,52 +19,201 @@
 #define NOINLINE __attribute__((noinline))
 #endif
 
-template <class T>
+// kHardware uses the BMI2 instructions. It is the default when compiling for
+//   BMI2, and can otherwise be selected explicitly for code that only runs
+//   inside TARGET_BMI2 functions after checking HardwarePextIsFast().
+enum class PextMode {
+  kSoftware,
+  kHardware
+};
+
+#ifdef __BMI2__
+constexpr PextMode kDefaultPextMode = PextMode::kHardware;
+#else
+constexpr PextMode kDefaultPextMode = PextMode::kSoftware;
+#endif
+
+#if defined(__BMI2__) || (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+#define HAS_BMI2_PATH
+#if defined(__GNUC__) && !defined(__BMI2__)
+#define TARGET_BMI2 __attribute__((target("bmi2")))
+#else
+#define TARGET_BMI2
+#endif
+
+TARGET_BMI2 inline uint32_t HardwarePext(uint32_t a, uint32_t mask) { return _pext_u32(a, mask); }
+TARGET_BMI2 inline uint64_t HardwarePext(uint64_t a, uint64_t mask) { return _pext_u64(a, mask); }
+TARGET_BMI2 inline uint32_t HardwarePdep(uint32_t a, uint32_t mask) { return _pdep_u32(a, mask); }
+TARGET_BMI2 inline uint64_t HardwarePdep(uint64_t a, uint64_t mask) { return _pdep_u64(a, mask); }
+#endif
+
+// Which path is taken at runtime, and why; for diagnostics. AMD before Zen 3
+//   (family 19h) implements pext/pdep in microcode, so they are much slower
+//   there than the software sequences.
+// Measured with the masks of the search (0x249249249249249, 0x5555555555,
+//   0x55555), ns per operation on an Intel Xeon (no AMD machine at hand):
+//                   hardware   pext<mask> software
+//     latency       1.5        5.0-5.9 (pext), 7.2-8.8 (pdep)
+//     4 independent 1.5 for 4  10.7-14.0 for 4
+//   Zen 3 has the same 3-cycle pipelined pext/pdep as Intel. The microcode of
+//   Zen 1 and 2 loops over the set bits of the mask; published instruction
+//   tables give it tens to hundreds of cycles with 10-20 bit masks like these,
+//   more than the software sequences.
+struct PextPath {
+  bool hardware;
+  const char* reason;
+};
+
+inline PextPath GetPextPath() {
+#if defined(HAS_BMI2_PATH) && defined(__GNUC__)
+  if (!__builtin_cpu_supports("bmi2")) return {false, "no BMI2 on this CPU"};
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return {false, "CPUID not available"};
+  bool is_amd = ebx == 0x68747541 || ebx == 0x6f677948; // "Auth"enticAMD, "Hygo"nGenuine
+  if (!is_amd) return {true, "BMI2 available"};
+  __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+  int family = eax >> 8 & 0xf;
+  if (family == 0xf) family += eax >> 20 & 0xff;
+  if (family < 0x19) return {false, "BMI2 microcoded on AMD before Zen 3"};
+  return {true, "BMI2 available"};
+#elif defined(HAS_BMI2_PATH)
+  return {true, "compiled for BMI2"};
+#else
+  return {false, "no BMI2 path in this build"};
+#endif
+}
+
+// Whether to take the BMI2 path at runtime
+inline bool HardwarePextIsFast() {
+  static const bool ret = GetPextPath().hardware;
+  return ret;
+}
+
+template <class T, PextMode mode = kDefaultPextMode>
 constexpr T pext(T a, T mask) {
   static_assert(
       std::is_same<T, uint32_t>::value ||
       std::is_same<T, uint64_t>::value,
       "not implemented");
-#ifdef __BMI2__
-  if (std::is_constant_evaluated()) {
-#endif
-    T res = 0;
-    for (T bb = 1; mask != 0; bb <<= 1) {
-      if (a & mask & -mask) res |= bb;
-      mask &= (mask - 1);
-    }
-    return res;
-#ifdef __BMI2__
-  } else if constexpr(std::is_same<T, uint64_t>::value) {
-    return _pext_u64(a, mask);
-  } else {
-    return _pext_u32(a, mask);
+  if constexpr (mode == PextMode::kHardware) {
+    if (!std::is_constant_evaluated()) return HardwarePext(a, mask);
   }
-#endif
+  T res = 0;
+  for (T bb = 1; mask != 0; bb <<= 1) {
+    if (a & mask & -mask) res |= bb;
+    mask &= (mask - 1);
+  }
+  return res;
 }
 
-template <class T>
+template <class T, PextMode mode = kDefaultPextMode>
 constexpr T pdep(T a, T mask) {
   static_assert(
       std::is_same<T, uint32_t>::value ||
       std::is_same<T, uint64_t>::value,
       "not implemented");
-#ifdef __BMI2__
-  if (std::is_constant_evaluated()) {
-#endif
-    T res = 0;
-    for (T bb = 1; mask; bb <<= 1) {
-      if (a & bb) res |= mask & -mask;
-      mask &= mask - 1;
+  if constexpr (mode == PextMode::kHardware) {
+    if (!std::is_constant_evaluated()) return HardwarePdep(a, mask);
+  }
+  T res = 0;
+  for (T bb = 1; mask; bb <<= 1) {
+    if (a & bb) res |= mask & -mask;
+    mask &= mask - 1;
+  }
+  return res;
+}
+
+// Precomputed way to do pext/pdep with a fixed mask on targets without BMI2.
+// Bits are either moved in groups that share the same shift distance, or by
+//   the log-step compress/expand network (Hacker's Delight 7-4 and 7-5);
+//   whichever needs fewer operations is used.
+template <class T>
+struct ConstMaskPlan {
+  static constexpr int kBits = sizeof(T) * 8;
+  static constexpr int kSteps = kBits == 64 ? 6 : 5;
+  struct Group {
+    T bits; // bits of the mask that move by the same distance
+    int shift;
+  };
+  std::array<Group, kBits> groups;
+  std::array<T, 6> steps;
+  int num_groups;
+  bool use_groups;
+
+  constexpr ConstMaskPlan(T mask) : groups(), steps(), num_groups(), use_groups() {
+    for (int src = 0, dst = 0; src < kBits; src++) {
+      if (!(mask >> src & 1)) continue;
+      int shift = src - dst++, i = 0;
+      while (i < num_groups && groups[i].shift != shift) i++;
+      if (i == num_groups) groups[num_groups++] = {0, shift};
+      groups[i].bits |= (T)1 << src;
     }
-    return res;
-#ifdef __BMI2__
-  } else if constexpr(std::is_same<T, uint64_t>::value) {
-    return _pdep_u64(a, mask);
+    T m = mask, mk = ~mask << 1;
+    int num_steps = 0;
+    for (int i = 0; i < kSteps; i++) {
+      T mp = mk ^ (mk << 1);
+      for (int j = 2; j < kBits; j <<= 1) mp ^= mp << j;
+      steps[i] = mp & m;
+      m = (m ^ steps[i]) | (steps[i] >> (1 << i));
+      mk &= ~mp;
+      if (steps[i]) num_steps++;
+    }
+    use_groups = num_groups * 3 - 1 <= num_steps * 4 + 1;
+  }
+};
+
+// pext/pdep with the mask as a template argument
+// usage: pext<kMask>(a) is equivalent to pext(a, kMask)
+// (the software path of these is much faster than the generic loop above)
+template <auto mask, PextMode mode = kDefaultPextMode>
+constexpr decltype(mask) pext(decltype(mask) a) {
+  using T = decltype(mask);
+  static_assert(
+      std::is_same<T, uint32_t>::value ||
+      std::is_same<T, uint64_t>::value,
+      "not implemented");
+  if constexpr (mode == PextMode::kHardware) {
+    if (!std::is_constant_evaluated()) return HardwarePext(a, mask);
+  }
+  constexpr ConstMaskPlan<T> plan(mask);
+  if constexpr (plan.use_groups) {
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return (T(0) | ... | ((a & plan.groups[I].bits) >> plan.groups[I].shift));
+    }(std::make_index_sequence<plan.num_groups>{});
   } else {
-    return _pdep_u32(a, mask);
+    T x = a & mask;
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      ((plan.steps[I] ? (void)(x = (x & ~plan.steps[I]) | (x & plan.steps[I]) >> (1 << I)) : (void)0), ...);
+    }(std::make_index_sequence<ConstMaskPlan<T>::kSteps>{});
+    return x;
+  }
+}
+
+template <auto mask, PextMode mode = kDefaultPextMode>
+constexpr decltype(mask) pdep(decltype(mask) a) {
+  using T = decltype(mask);
+  static_assert(
+      std::is_same<T, uint32_t>::value ||
+      std::is_same<T, uint64_t>::value,
+      "not implemented");
+  if constexpr (mode == PextMode::kHardware) {
+    if (!std::is_constant_evaluated()) return HardwarePdep(a, mask);
+  }
+  constexpr ConstMaskPlan<T> plan(mask);
+  if constexpr (plan.use_groups) {
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return (T(0) | ... | ((a << plan.groups[I].shift) & plan.groups[I].bits));
+    }(std::make_index_sequence<plan.num_groups>{});
+  } else {
+    constexpr int N = ConstMaskPlan<T>::kSteps;
+    T x = a;
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      ((plan.steps[N - 1 - I] ?
+            (void)(x = (x & ~plan.steps[N - 1 - I]) | (x << (1 << (N - 1 - I)) & plan.steps[N - 1 - I])) :
+            (void)0), ...);
+    }(std::make_index_sequence<N>{});
+    return x & mask;
   }
-#endif
 }
 
 template <class T>
@@ -106,6 +263,18 @@ constexpr int clz(T a) {
 #endif
 }
 
+// transpose an 8x8 bit matrix: bit (8*i+j) <-> bit (8*j+i)
+// (Hacker's Delight 7-3)
+constexpr uint64_t Transpose8x8(uint64_t x) {
+  uint64_t t = (x ^ x >> 7) & 0x00aa00aa00aa00aa;
+  x ^= t ^ t << 7;
+  t = (x ^ x >> 14) & 0x0000cccc0000cccc;
+  x ^= t ^ t << 14;
+  t = (x ^ x >> 28) & 0x00000000f0f0f0f0;
+  x ^= t ^ t << 28;
+  return x;
+}
+
 [[noreturn]] inline void unreachable() {
 #ifdef __GNUC__ // GCC, Clang, ICC
   __builtin_unreachable();
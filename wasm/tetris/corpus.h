@@ -0,0 +1,288 @@
+#pragma once
+
+// Binary board corpus for native batch tools (not used by the wasm module).
+//
+// File layout (little endian):
+//   header, 32 bytes: magic "BTPGCORP", u32 version, u32 record size, u64
+//     number of records, 8 reserved bytes
+//   records, 32 bytes each:
+//     0-24  Board::ToBytes
+//     25    piece
+//     26-27 u16 lines
+//     28    tap speed (TapSpeed in taps.h, < kTapSpeeds)
+//     29    adj delay in frames
+//     30-31 reserved
+//
+// CorpusReader maps the file read-only and decodes records in place, so
+//   opening is O(1) and the data is read straight from the page cache.
+
+#include <string>
+#include <limits>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "board.h"
+#include "taps.h"
+
+struct CorpusRecord {
+  Board board;
+  int piece;
+  int lines;
+  int tap_speed;
+  int adj_delay;
+
+  static constexpr size_t kBytes = 32;
+
+  constexpr void ToBytes(uint8_t buf[kBytes]) const {
+    board.ToBytes(buf);
+    buf[25] = piece;
+    buf[26] = lines;
+    buf[27] = lines >> 8;
+    buf[28] = tap_speed;
+    buf[29] = adj_delay;
+    buf[30] = buf[31] = 0;
+  }
+  static constexpr CorpusRecord FromBytes(const uint8_t buf[kBytes]) {
+    return {Board(buf), buf[25], buf[26] | buf[27] << 8, buf[28], buf[29]};
+  }
+};
+
+namespace corpus {
+
+constexpr char kMagic[8] = {'B', 'T', 'P', 'G', 'C', 'O', 'R', 'P'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderBytes = 32;
+
+constexpr uint32_t ReadU32(const uint8_t x[]) {
+  return x[0] | x[1] << 8 | x[2] << 16 | (uint32_t)x[3] << 24;
+}
+constexpr void WriteU32(uint32_t v, uint8_t x[]) {
+  for (int i = 0; i < 4; i++) x[i] = v >> (i * 8);
+}
+
+// returns -1 on invalid characters
+constexpr int Base64Value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+' || c == '-') return 62;
+  if (c == '/' || c == '_') return 63;
+  return -1;
+}
+
+// decode standard or URL-safe base64 into exactly kBoardBytes bytes
+inline void DecodeBoardBase64(std::string_view sv, uint8_t buf[kBoardBytes]) {
+  while (!sv.empty() && sv.back() == '=') sv.remove_suffix(1);
+  if (sv.size() != (kBoardBytes * 4 + 2) / 3) throw std::runtime_error("invalid base64 board length");
+  uint32_t acc = 0;
+  int bits = 0, n = 0;
+  for (char c : sv) {
+    int v = Base64Value(c);
+    if (v < 0) throw std::runtime_error("invalid base64 character");
+    acc = acc << 6 | v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      buf[n++] = acc >> bits;
+    }
+  }
+}
+
+} // namespace corpus
+
+class CorpusWriter {
+  FILE* fp_;
+  uint64_t count_;
+
+  bool WriteHeader_() {
+    uint8_t header[corpus::kHeaderBytes] = {};
+    memcpy(header, corpus::kMagic, sizeof(corpus::kMagic));
+    corpus::WriteU32(corpus::kVersion, header + 8);
+    corpus::WriteU32(CorpusRecord::kBytes, header + 12);
+    IntToBytes<uint64_t>(count_, header + 16);
+    return fseek(fp_, 0, SEEK_SET) == 0 && fwrite(header, sizeof(header), 1, fp_) == 1;
+  }
+ public:
+  explicit CorpusWriter(const std::string& path) : fp_(fopen(path.c_str(), "wb")), count_() {
+    if (!fp_) throw std::runtime_error("cannot open " + path);
+    if (!WriteHeader_()) {
+      fclose(fp_);
+      throw std::runtime_error("failed to write corpus header");
+    }
+  }
+  CorpusWriter(const CorpusWriter&) = delete;
+  CorpusWriter& operator=(const CorpusWriter&) = delete;
+  // finalizes the file as Close does, but errors are ignored
+  ~CorpusWriter() {
+    if (!fp_) return;
+    WriteHeader_();
+    fclose(fp_);
+  }
+
+  void Write(const CorpusRecord& record) {
+    uint8_t buf[CorpusRecord::kBytes];
+    record.ToBytes(buf);
+    if (fwrite(buf, sizeof(buf), 1, fp_) != 1) throw std::runtime_error("failed to write corpus record");
+    count_++;
+  }
+  uint64_t size() const { return count_; }
+
+  // write the record count into the header and close the file; unlike the
+  //   destructor, this reports errors
+  void Close() {
+    bool ok = WriteHeader_();
+    ok = fclose(fp_) == 0 && ok;
+    fp_ = nullptr;
+    if (!ok) throw std::runtime_error("failed to close corpus");
+  }
+};
+
+class CorpusReader {
+  const uint8_t* data_;
+  size_t map_size_;
+  uint64_t count_;
+
+ public:
+  explicit CorpusReader(const std::string& path) : data_(), map_size_(), count_() {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < corpus::kHeaderBytes) {
+      close(fd);
+      throw std::runtime_error("invalid corpus " + path);
+    }
+    map_size_ = st.st_size;
+    void* ptr = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) throw std::runtime_error("cannot map " + path);
+    data_ = static_cast<const uint8_t*>(ptr);
+    madvise(ptr, map_size_, MADV_SEQUENTIAL);
+
+    count_ = BytesToInt<uint64_t>(data_ + 16);
+    if (memcmp(data_, corpus::kMagic, sizeof(corpus::kMagic)) != 0 ||
+        corpus::ReadU32(data_ + 8) != corpus::kVersion ||
+        corpus::ReadU32(data_ + 12) != CorpusRecord::kBytes ||
+        count_ > (map_size_ - corpus::kHeaderBytes) / CorpusRecord::kBytes) {
+      munmap(ptr, map_size_);
+      throw std::runtime_error("invalid corpus " + path);
+    }
+  }
+  CorpusReader(const CorpusReader&) = delete;
+  CorpusReader& operator=(const CorpusReader&) = delete;
+  ~CorpusReader() {
+    munmap(const_cast<uint8_t*>(data_), map_size_);
+  }
+
+  size_t size() const { return count_; }
+  // raw bytes of record i, valid as long as the reader is
+  const uint8_t* RecordBytes(size_t i) const {
+    return data_ + corpus::kHeaderBytes + i * CorpusRecord::kBytes;
+  }
+  // throws if the piece or tap speed is out of range, so that the record can
+  //   be used to index the piece and tap tables
+  CorpusRecord operator[](size_t i) const {
+    CorpusRecord ret = CorpusRecord::FromBytes(RecordBytes(i));
+    if (ret.piece >= (int)kPieces || ret.tap_speed >= kTapSpeeds) {
+      throw std::runtime_error("invalid corpus record " + std::to_string(i));
+    }
+    return ret;
+  }
+
+  class Iterator {
+    const CorpusReader* reader_;
+    size_t idx_;
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = CorpusRecord;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator(const CorpusReader* reader, size_t idx) : reader_(reader), idx_(idx) {}
+    CorpusRecord operator*() const { return (*reader_)[idx_]; }
+    Iterator& operator++() {
+      idx_++;
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator ret = *this;
+      idx_++;
+      return ret;
+    }
+    bool operator==(const Iterator& x) const { return idx_ == x.idx_; }
+  };
+  Iterator begin() const { return {this, 0}; }
+  Iterator end() const { return {this, count_}; }
+};
+
+// Convert a text corpus with one record per line:
+//   <board> <piece> <lines> <tap speed> <adj delay>
+// separated by spaces or tabs, where <board> is either
+// - the text layout read by Board(std::string_view): rows of 10 cells from
+//   top to bottom, each followed by one separator character except the last
+//   ('1', 'X' or 'O' are filled cells). As in that constructor, fewer than 20
+//   rows are the bottom rows of the board. Since the fields are separated by
+//   whitespace, rows are joined by a character such as '/', e.g.
+//   "0000000000/1111011111" for two bottom rows; or
+// - the base64 encoding of Board::ToBytes (as in the web query objects).
+// <piece> and <tap speed> are the Piece and TapSpeed values. Empty lines and
+//   lines starting with '#' are skipped. Returns the number of records written.
+inline uint64_t ConvertTextCorpus(std::istream& in, CorpusWriter& out) {
+  uint64_t num = 0;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::string_view sv = line;
+    auto next_field = [&]() {
+      size_t start = sv.find_first_not_of(" \t\r");
+      if (start == std::string_view::npos) return std::string_view();
+      sv.remove_prefix(start);
+      size_t end = std::min(sv.find_first_of(" \t\r"), sv.size());
+      std::string_view ret = sv.substr(0, end);
+      sv.remove_prefix(end);
+      return ret;
+    };
+    auto next_int = [&]() {
+      std::string_view field = next_field();
+      if (field.empty()) throw std::runtime_error("missing field: " + line);
+      int ret = 0;
+      for (char c : field) {
+        if (c < '0' || c > '9') throw std::runtime_error("invalid number: " + line);
+        if (ret > (std::numeric_limits<int>::max() - (c - '0')) / 10) {
+          throw std::runtime_error("value out of range: " + line);
+        }
+        ret = ret * 10 + (c - '0');
+      }
+      return ret;
+    };
+    std::string_view board_str = next_field();
+    if (board_str.empty() || board_str[0] == '#') continue;
+
+    CorpusRecord record;
+    if ((board_str.size() + 1) % 11 == 0) {
+      if (board_str.size() > 20 * 11 - 1) throw std::runtime_error("invalid board: " + line);
+      record.board = Board(board_str);
+    } else {
+      uint8_t buf[kBoardBytes];
+      corpus::DecodeBoardBase64(board_str, buf);
+      record.board = Board(buf);
+    }
+    record.piece = next_int();
+    record.lines = next_int();
+    record.tap_speed = next_int();
+    record.adj_delay = next_int();
+    if (record.piece >= (int)kPieces || record.lines > 0xffff ||
+        record.tap_speed >= kTapSpeeds || record.adj_delay > 0xff) {
+      throw std::runtime_error("value out of range: " + line);
+    }
+    out.Write(record);
+    num++;
+  }
+  return num;
+}
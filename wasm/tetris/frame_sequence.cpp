@@ -208,7 +208,7 @@ constexpr std::array<uint32_t, 20> DirectionMapNoro(const Board& b, int inputs_p
   std::array<uint32_t, 20> ret = {};
   constexpr uint32_t kMask = 0x9249249;
   for (auto& row : rows) {
-    row = pdep(row, kMask);
+    row = pdep<kMask>(row);
     row = row | row << 1 | row << 2;
   }
   if (do_tuck && inputs_per_row) {
@@ -7,6 +7,13 @@ enum Level {
   kLevel39
 };
 
+// dispatch a runtime level to ONE_CASE(kLevelXX), like DO_PIECE_CASE
+#define DO_LEVEL_CASE(level) \
+  switch (level) { \
+    ONE_CASE(kLevel18) ONE_CASE(kLevel19) ONE_CASE(kLevel29) ONE_CASE(kLevel39) \
+  } \
+  unreachable();
+
 alignas(32) constexpr float kTransitionProb[][8] = {
   {1./32, 5./32, 6./32, 5./32, 5./32, 5./32, 5./32}, // T
   {6./32, 1./32, 5./32, 5./32, 5./32, 5./32, 5./32}, // J
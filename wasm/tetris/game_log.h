@@ -0,0 +1,176 @@
+#pragma once
+
+// Compact record of one game: the starting board followed by the moves.
+//
+// Layout:
+//   header: "BTGL", u8 version, Board::ToBytes of the starting board
+//   each move: u8 piece | kHasPremove_, Position::GetBytes of the final
+//     position, then Position::GetBytes of the adj premove if present
+//
+// So a move takes 3 bytes, or 5 with a premove. Boards are rebuilt by
+//   replaying Board::Place and ClearLines; GameLogReader keeps a board every
+//   kCheckpointInterval moves so that any move can be reached by replaying at
+//   most that many moves.
+
+#include <array>
+#include <vector>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+
+#include "board.h"
+#include "position.h"
+
+namespace game_log {
+
+constexpr char kMagic[4] = {'B', 'T', 'G', 'L'};
+constexpr uint8_t kVersion = 1;
+constexpr size_t kHeaderBytes = sizeof(kMagic) + 1 + kBoardBytes;
+constexpr uint8_t kPieceMask = 0x7;
+constexpr uint8_t kHasPremove = 0x8;
+
+// kPlaceable[piece][r] has bit (x, y) set if the piece fits on the board there
+inline constexpr auto kPlaceable = [] {
+  std::array<std::array<Board, 4>, kPieces> ret{};
+  auto maps = Board::Ones.GetAllPieceMaps();
+  [&]<size_t... piece>(std::index_sequence<piece...>) {
+    ((std::copy(std::get<piece>(maps).begin(), std::get<piece>(maps).end(), ret[piece].begin())), ...);
+  }(std::make_index_sequence<kPieces>());
+  return ret;
+}();
+
+} // namespace game_log
+
+struct GameLogMove {
+  int piece;
+  Position pos;
+  Position premove; // Position::Invalid if the piece was placed without adjustment
+};
+
+class GameLogWriter {
+  std::vector<uint8_t> bytes_;
+  size_t num_moves_;
+ public:
+  explicit GameLogWriter(const Board& start) : bytes_(game_log::kHeaderBytes), num_moves_() {
+    memcpy(bytes_.data(), game_log::kMagic, sizeof(game_log::kMagic));
+    bytes_[sizeof(game_log::kMagic)] = game_log::kVersion;
+    start.ToBytes(bytes_.data() + sizeof(game_log::kMagic) + 1);
+  }
+
+  void Add(const GameLogMove& move) {
+    bool has_premove = move.premove != Position::Invalid;
+    bytes_.push_back(move.piece | (has_premove ? game_log::kHasPremove : 0));
+    size_t offset = bytes_.size();
+    bytes_.resize(offset + Position::NumBytes() * (has_premove ? 2 : 1));
+    move.pos.GetBytes(bytes_.data() + offset);
+    if (has_premove) move.premove.GetBytes(bytes_.data() + offset + Position::NumBytes());
+    num_moves_++;
+  }
+
+  size_t NumMoves() const { return num_moves_; }
+  const std::vector<uint8_t>& Bytes() const { return bytes_; }
+};
+
+// Reads a log from memory (e.g. a mapped file); the bytes must outlive it.
+class GameLogReader {
+ public:
+  static constexpr size_t kCheckpointInterval = 32;
+
+ private:
+  struct Checkpoint {
+    Board board; // before the move
+    size_t offset;
+  };
+  const uint8_t* data_;
+  size_t size_;
+  size_t num_moves_;
+  std::vector<Checkpoint> checkpoints_;
+
+  size_t ReadMove_(size_t offset, GameLogMove& move) const {
+    if (offset >= size_) throw std::runtime_error("truncated game log");
+    uint8_t flags = data_[offset++];
+    move.piece = flags & game_log::kPieceMask;
+    if (move.piece >= (int)kPieces || (flags & ~(game_log::kPieceMask | game_log::kHasPremove))) {
+      throw std::runtime_error("invalid game log");
+    }
+    size_t len = Position::NumBytes() * (flags & game_log::kHasPremove ? 2 : 1);
+    if (offset + len > size_) throw std::runtime_error("truncated game log");
+    move.pos = Position(data_ + offset, Position::NumBytes());
+    move.premove = flags & game_log::kHasPremove ?
+        Position(data_ + offset + Position::NumBytes(), Position::NumBytes()) : Position::Invalid;
+    // the positions are placed as they are, so they must be on the board
+    auto Valid = [&](const Position& pos) {
+      return pos.r < Board::NumRotations(move.piece) && pos.x < 20 && pos.y < 10 &&
+          game_log::kPlaceable[move.piece][pos.r].IsCellSet(pos.x, pos.y);
+    };
+    if (!Valid(move.pos) || (flags & game_log::kHasPremove && !Valid(move.premove))) {
+      throw std::runtime_error("invalid game log");
+    }
+    return offset + len;
+  }
+
+  static Board Apply_(const Board& b, const GameLogMove& move) {
+    return b.Place(move.piece, move.pos.r, move.pos.x, move.pos.y).ClearLines().second;
+  }
+
+ public:
+  GameLogReader(const uint8_t* data, size_t size) : data_(data), size_(size), num_moves_() {
+    if (size < game_log::kHeaderBytes ||
+        memcmp(data, game_log::kMagic, sizeof(game_log::kMagic)) != 0 ||
+        data[sizeof(game_log::kMagic)] != game_log::kVersion) {
+      throw std::runtime_error("invalid game log");
+    }
+    Board board(data + sizeof(game_log::kMagic) + 1);
+    GameLogMove move;
+    for (size_t offset = game_log::kHeaderBytes; offset < size_; num_moves_++) {
+      if (num_moves_ % kCheckpointInterval == 0) checkpoints_.push_back({board, offset});
+      offset = ReadMove_(offset, move);
+      board = Apply_(board, move);
+    }
+    if (num_moves_ % kCheckpointInterval == 0) checkpoints_.push_back({board, size_});
+  }
+  explicit GameLogReader(const std::vector<uint8_t>& bytes) : GameLogReader(bytes.data(), bytes.size()) {}
+
+  size_t NumMoves() const { return num_moves_; }
+
+  // Sequential replay from a given move.
+  class Cursor {
+    const GameLogReader* reader_;
+    size_t offset_;
+    size_t idx_;
+    Board board_;
+    GameLogMove move_;
+    friend class GameLogReader;
+    Cursor(const GameLogReader* reader, size_t offset, size_t idx, const Board& board) :
+        reader_(reader), offset_(offset), idx_(idx), board_(board), move_() {}
+   public:
+    bool Done() const { return idx_ >= reader_->num_moves_; }
+    size_t Index() const { return idx_; }
+    // the board before the current move
+    const Board& GetBoard() const { return board_; }
+    // the current move; throws std::out_of_range if Done()
+    GameLogMove GetMove() const {
+      if (Done()) throw std::out_of_range("move index out of range");
+      GameLogMove move;
+      reader_->ReadMove_(offset_, move);
+      return move;
+    }
+    void Next() {
+      if (Done()) throw std::out_of_range("move index out of range");
+      offset_ = reader_->ReadMove_(offset_, move_);
+      board_ = Apply_(board_, move_);
+      idx_++;
+    }
+  };
+
+  // idx can be NumMoves(), giving the final board
+  Cursor Seek(size_t idx) const {
+    if (idx > num_moves_) throw std::out_of_range("move index out of range");
+    const Checkpoint& c = checkpoints_[idx / kCheckpointInterval];
+    Cursor cursor(this, c.offset, idx / kCheckpointInterval * kCheckpointInterval, c.board);
+    while (cursor.idx_ < idx) cursor.Next();
+    return cursor;
+  }
+  Board BoardAt(size_t idx) const { return Seek(idx).GetBoard(); }
+  GameLogMove MoveAt(size_t idx) const { return Seek(idx).GetMove(); }
+};
@@ -1,12 +1,61 @@
 #pragma once
 
+#include <new>
+#include <array>
+#include <tuple>
+#include <memory>
 #include <vector>
+#include <iterator>
 #include <algorithm>
 
 #include "game.h"
 #include "board.h"
 #include "position.h"
 
+namespace move_search {
+
+constexpr int kMaxGroupSize = 256; // positions found by one search phase
+constexpr int kMaxAdj = 40; // one per initial (rot, col)
+
+// Where a search writes the lock positions it finds: a list of Positions in
+//   the order they are found, ...
+class PositionList {
+  std::array<Position, kMaxGroupSize> positions_;
+  int size_;
+ public:
+  constexpr PositionList() : size_() {}
+  constexpr void Clear() { size_ = 0; }
+  constexpr void Add(int rot, int row, int col) { positions_[size_++] = {rot, row, col}; }
+  // rows is a bitmask as Column
+  constexpr void AddColumn(int rot, int col, uint32_t rows) {
+    for (; rows; rows &= rows - 1) Add(rot, ctz(rows), col);
+  }
+  constexpr bool empty() const { return !size_; }
+  constexpr const Position* data() const { return positions_.data(); }
+  constexpr int size() const { return size_; }
+};
+
+// ... or a bitmask of lock rows for each (rot, col)
+template <int R>
+class PositionColumns {
+  std::array<std::array<uint32_t, 10>, R> rows_;
+ public:
+  constexpr PositionColumns() : rows_() {}
+  constexpr void Clear() { rows_ = {}; }
+  constexpr void Add(int rot, int row, int col) { rows_[rot][col] |= 1 << row; }
+  constexpr void AddColumn(int rot, int col, uint32_t rows) { rows_[rot][col] |= rows; }
+  constexpr bool empty() const {
+    uint32_t ret = 0;
+    for (auto& i : rows_) {
+      for (auto j : i) ret |= j;
+    }
+    return !ret;
+  }
+  constexpr uint32_t Rows(int rot, int col) const { return rows_[rot][col]; }
+};
+
+} // namespace move_search
+
 class PossibleMoves {
   static void UniqueVector_(std::vector<Position>& p, bool unique) {
     std::sort(p.begin(), p.end());
@@ -20,6 +69,196 @@ class PossibleMoves {
     for (auto& i : adj) UniqueVector_(i.second, unique);
     std::sort(adj.begin(), adj.end());
   }
+
+  // output interface of the search (shared with CompactPossibleMoves and
+  //   BitboardPossibleMoves)
+  template <int R> using Output = move_search::PositionList;
+  void SetNonAdj(const Output<1>& out) { non_adj.assign(out.data(), out.data() + out.size()); }
+  void AddAdj(const Position& premove, const Output<1>& out) {
+    adj.emplace_back(premove, std::vector<Position>(out.data(), out.data() + out.size()));
+  }
+};
+
+// PossibleMoves in compressed sparse row form. All positions are packed into
+//   one fixed buffer, 2 bytes each (the fields of Position::GetBytes, ordered
+//   so that packed values compare like Positions); non_adj is the first group
+//   and each adj premove owns the group after it. Filling it never allocates,
+//   so one object can be reused across searches.
+class CompactPossibleMoves {
+ public:
+  static constexpr int kMaxGroupSize = move_search::kMaxGroupSize;
+  static constexpr int kMaxAdj = move_search::kMaxAdj;
+
+  static constexpr uint16_t Pack(const Position& p) { return p.r << 13 | p.x << 8 | p.y; }
+  static constexpr Position Unpack(uint16_t x) { return {x >> 13, x >> 8 & 31, x & 255}; }
+
+  class Group {
+    const uint16_t* begin_;
+    const uint16_t* end_;
+   public:
+    class Iterator {
+      const uint16_t* ptr_;
+     public:
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type = Position;
+      using difference_type = std::ptrdiff_t;
+
+      constexpr Iterator() : ptr_() {}
+      constexpr explicit Iterator(const uint16_t* ptr) : ptr_(ptr) {}
+      constexpr Position operator*() const { return Unpack(*ptr_); }
+      constexpr Position operator[](difference_type i) const { return Unpack(ptr_[i]); }
+      constexpr Iterator& operator++() { ptr_++; return *this; }
+      constexpr Iterator operator++(int) { return Iterator(ptr_++); }
+      constexpr Iterator& operator--() { ptr_--; return *this; }
+      constexpr Iterator operator--(int) { return Iterator(ptr_--); }
+      constexpr Iterator& operator+=(difference_type i) { ptr_ += i; return *this; }
+      constexpr Iterator& operator-=(difference_type i) { ptr_ -= i; return *this; }
+      constexpr Iterator operator+(difference_type i) const { return Iterator(ptr_ + i); }
+      friend constexpr Iterator operator+(difference_type i, const Iterator& x) { return x + i; }
+      constexpr Iterator operator-(difference_type i) const { return Iterator(ptr_ - i); }
+      constexpr difference_type operator-(const Iterator& x) const { return ptr_ - x.ptr_; }
+      constexpr auto operator<=>(const Iterator&) const = default;
+    };
+
+    constexpr Group(const uint16_t* begin, const uint16_t* end) : begin_(begin), end_(end) {}
+    constexpr Iterator begin() const { return Iterator(begin_); }
+    constexpr Iterator end() const { return Iterator(end_); }
+    constexpr size_t size() const { return end_ - begin_; }
+    constexpr bool empty() const { return begin_ == end_; }
+    constexpr Position operator[](size_t i) const { return Unpack(begin_[i]); }
+  };
+
+ private:
+  std::array<uint16_t, kMaxGroupSize * (kMaxAdj + 1)> positions_;
+  // group i is [offsets_[i], offsets_[i+1])
+  std::array<uint16_t, kMaxAdj + 2> offsets_;
+  std::array<uint16_t, kMaxAdj> premoves_;
+  int num_adj_;
+
+  constexpr void Append_(const Position* positions, int n) {
+    uint16_t* out = positions_.data() + offsets_[num_adj_ + 1];
+    for (int i = 0; i < n; i++) out[i] = Pack(positions[i]);
+  }
+
+ public:
+  constexpr CompactPossibleMoves() : offsets_(), num_adj_() {}
+
+  constexpr Group NonAdj() const { return {positions_.data(), positions_.data() + offsets_[1]}; }
+  constexpr int NumAdj() const { return num_adj_; }
+  constexpr Position Premove(int i) const { return Unpack(premoves_[i]); }
+  constexpr Group Adj(int i) const {
+    return {positions_.data() + offsets_[i + 1], positions_.data() + offsets_[i + 2]};
+  }
+  constexpr size_t TotalPositions() const { return offsets_[num_adj_ + 1]; }
+
+  template <int R> using Output = move_search::PositionList;
+  // the other positions are discarded
+  constexpr void SetNonAdj(const Output<1>& out) {
+    num_adj_ = 0;
+    offsets_[1] = 0;
+    Append_(out.data(), out.size());
+    offsets_[1] = out.size();
+  }
+  constexpr void AddAdj(const Position& premove, const Output<1>& out) {
+    premoves_[num_adj_] = Pack(premove);
+    Append_(out.data(), out.size());
+    offsets_[num_adj_ + 2] = offsets_[num_adj_ + 1] + out.size();
+    num_adj_++;
+  }
+
+  PossibleMoves ToPossibleMoves() const {
+    PossibleMoves ret;
+    ret.non_adj.assign(NonAdj().begin(), NonAdj().end());
+    for (int i = 0; i < num_adj_; i++) {
+      ret.adj.emplace_back(Premove(i), std::vector<Position>(Adj(i).begin(), Adj(i).end()));
+    }
+    return ret;
+  }
+};
+
+// A set of positions as bitmaps: bit (x, y) of boards[r], as in
+//   Board::IsCellSet, is set if Position{r, x, y} is in the set. Rotations a
+//   piece does not have are always empty.
+struct PositionSet {
+  std::array<Board, 4> boards;
+
+  constexpr PositionSet() : boards{{{0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}} {}
+  template <int R>
+  constexpr explicit PositionSet(const move_search::PositionColumns<R>& x) : PositionSet() {
+    for (int r = 0; r < R; r++) {
+      auto Col = [&](int col) -> uint64_t { return x.Rows(r, col); };
+      boards[r] = {Col(0) | Col(1) << 22 | Col(2) << 44,
+                   Col(3) | Col(4) << 22 | Col(5) << 44,
+                   Col(6) | Col(7) << 22 | Col(8) << 44, Col(9)};
+    }
+  }
+
+  constexpr bool Contains(const Position& p) const { return boards[p.r].IsCellSet(p.x, p.y); }
+  constexpr int Count() const {
+    int ret = 0;
+    for (auto& b : boards) ret += popcount(b.b1) + popcount(b.b2) + popcount(b.b3) + popcount(b.b4);
+    return ret;
+  }
+  constexpr bool Empty() const { return *this == PositionSet(); }
+  constexpr bool IsSubsetOf(const PositionSet& x) const { return (*this & x) == *this; }
+
+  constexpr PositionSet& operator|=(const PositionSet& x) {
+    for (int r = 0; r < 4; r++) boards[r] |= x.boards[r];
+    return *this;
+  }
+  constexpr PositionSet& operator&=(const PositionSet& x) {
+    for (int r = 0; r < 4; r++) boards[r] &= x.boards[r];
+    return *this;
+  }
+  constexpr PositionSet operator|(const PositionSet& x) const { return PositionSet(*this) |= x; }
+  constexpr PositionSet operator&(const PositionSet& x) const { return PositionSet(*this) &= x; }
+  constexpr bool operator==(const PositionSet& x) const = default;
+
+  // sorted
+  std::vector<Position> ToPositions() const {
+    std::vector<Position> ret;
+    for (int r = 0; r < 4; r++) {
+      for (int col = 0; col < 10; col++) {
+        for (uint32_t rows = boards[r].Column(col); rows; rows &= rows - 1) ret.push_back({r, ctz(rows), col});
+      }
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+  }
+};
+
+// Search result as position bitmaps, one for the placements without
+//   adjustment and one per adj premove. The search writes lock rows per column
+//   straight into it without going through Positions.
+class BitboardPossibleMoves {
+ public:
+  static constexpr int kMaxAdj = move_search::kMaxAdj;
+
+  PositionSet non_adj;
+  int num_adj;
+  std::array<Position, kMaxAdj> premoves;
+  std::array<PositionSet, kMaxAdj> adj;
+
+  constexpr BitboardPossibleMoves() : non_adj(), num_adj(), premoves(), adj() {}
+
+  template <int R> using Output = move_search::PositionColumns<R>;
+  template <int R>
+  constexpr void SetNonAdj(const Output<R>& out) {
+    non_adj = PositionSet(out);
+    num_adj = 0;
+  }
+  template <int R>
+  constexpr void AddAdj(const Position& premove, const Output<R>& out) {
+    premoves[num_adj] = premove;
+    adj[num_adj++] = PositionSet(out);
+  }
+
+  // union of all placements, with or without adjustment
+  constexpr PositionSet All() const {
+    PositionSet ret = non_adj;
+    for (int i = 0; i < num_adj; i++) ret |= adj[i];
+    return ret;
+  }
 };
 
 namespace move_search {
@@ -75,14 +314,6 @@ constexpr int sgn(int x) {
   return x == 0 ? 0 : x > 0 ? 1 : -1;
 }
 
-// Check each bit in mask is set in board
-template <int R>
-constexpr bool Contains4(const std::array<Board, R>& board, const std::array<Board, 4>& mask) {
-  bool ret = true;
-  for (int i = 0; i < R; i++) ret &= (board[i] & mask[i]) == mask[i];
-  return ret;
-}
-
 struct TableEntryNoTmpl {
   uint8_t rot, col, num_taps;
   std::array<Board, 4> masks_nodrop;
@@ -215,17 +446,249 @@ constexpr int Phase1TableGen(
   }
 }
 
-struct Phase1TableNoTmpl {
-  std::vector<TableEntryNoTmpl> initial;
-  std::vector<std::vector<TableEntryNoTmpl>> adj;
-  constexpr Phase1TableNoTmpl(Level level, int R, int adj_frame, const int taps[]) : initial(40) {
-    initial.resize(10 * R);
-    initial.resize(Phase1TableGen(level, R, taps, 0, 0, Position::Start.y, initial.data()));
-    for (auto& i : initial) {
-      int frame_start = std::max(adj_frame, taps[i.num_taps]);
-      adj.emplace_back(10 * R);
-      adj.back().resize(Phase1TableGen(level, R, taps, frame_start, i.rot, i.col, adj.back().data()));
+// Generate the initial table followed by the adj table of each initial entry
+//   into entries; table i (0 is the initial table) is [bounds[i], bounds[i+1]).
+// entries needs room for Phase1TableCapacity(R) entries and bounds for 10R+2.
+// Returns the size of the initial table.
+constexpr int Phase1TableCapacity(int R) { return 10 * R * (10 * R + 1); }
+
+constexpr int Phase1TableFill(
+    Level level, int R, int adj_frame, const int taps[], TableEntryNoTmpl entries[], int bounds[]) {
+  int n = Phase1TableGen(level, R, taps, 0, 0, Position::Start.y, entries);
+  bounds[0] = 0;
+  bounds[1] = n;
+  for (int i = 0; i < n; i++) {
+    int frame_start = std::max(adj_frame, taps[entries[i].num_taps]);
+    bounds[i + 2] = bounds[i + 1] + Phase1TableGen(
+        level, R, taps, frame_start, entries[i].rot, entries[i].col, entries + bounds[i + 1]);
+  }
+  return n;
+}
+
+// Entry as stored in Phase1TableNoTmpl; its R masks are kept separately so
+//   that the masks of the whole table form one dense array
+struct Phase1Entry {
+  uint8_t rot, col, num_taps;
+};
+
+// entries [begin, begin + size) of a Phase1TableNoTmpl
+struct Phase1Range {
+  uint16_t begin, size;
+};
+
+// entries tested at once by Phase1TableNoTmpl::CanReach
+constexpr int kReachBlock = 8;
+// Distance between two mask words of the same entry in a table of size
+//   entries (see Phase1TableNoTmpl); the last block of a range may read
+//   kReachBlock - 1 entries past the end of the table
+constexpr int Phase1MaskStride(int size) { return (size + kReachBlock - 1 + 3) / 4 * 4; }
+
+// Split the output of Phase1TableFill into entries, masks and the ranges of
+//   the adj tables; identical adj tables (in practice, those of initial
+//   entries that cannot be reached at all) share one range.
+// Word w of masks_nodrop[r] of entry i goes to masks[(r * 4 + w) * stride + i].
+// Returns the number of entries written, which is at most bounds[num_initial + 1].
+constexpr int Phase1TableCompact(
+    int R, const TableEntryNoTmpl generated[], const int bounds[], int num_initial,
+    Phase1Entry entries[], uint64_t masks[], int stride, Phase1Range adj[]) {
+  auto SameEntry = [&](const TableEntryNoTmpl& a, const TableEntryNoTmpl& b) {
+    if (a.rot != b.rot || a.col != b.col || a.num_taps != b.num_taps) return false;
+    for (int r = 0; r < R; r++) {
+      if (a.masks_nodrop[r] != b.masks_nodrop[r]) return false;
+    }
+    return true;
+  };
+  auto SameTable = [&](int x, int y) {
+    if (bounds[x + 2] - bounds[x + 1] != bounds[y + 2] - bounds[y + 1]) return false;
+    for (int j = 0; j < bounds[x + 2] - bounds[x + 1]; j++) {
+      if (!SameEntry(generated[bounds[x + 1] + j], generated[bounds[y + 1] + j])) return false;
+    }
+    return true;
+  };
+  auto Push = [&](int sz, int idx) {
+    const TableEntryNoTmpl& e = generated[idx];
+    entries[sz] = {e.rot, e.col, e.num_taps};
+    for (int r = 0; r < R; r++) {
+      const Board& m = e.masks_nodrop[r];
+      const uint64_t words[4] = {m.b1, m.b2, m.b3, m.b4};
+      for (int w = 0; w < 4; w++) masks[(r * 4 + w) * stride + sz] = words[w];
+    }
+  };
+  int sz = 0;
+  for (int i = 0; i < num_initial; i++) Push(sz++, i);
+  for (int i = 0; i < num_initial; i++) {
+    int begin = bounds[i + 1], size = bounds[i + 2] - begin;
+    int same = 0;
+    while (same < i && !SameTable(same, i)) same++;
+    if (same < i) {
+      adj[i] = adj[same];
+      continue;
+    }
+    adj[i] = {(uint16_t)sz, (uint16_t)size};
+    for (int j = 0; j < size; j++) Push(sz++, begin + j);
+  }
+  return sz;
+}
+
+// The initial table and all adj tables of one configuration, stored in two
+//   contiguous arrays: 3-byte entries, and the masks of all entries. The masks
+//   are transposed (R * 4 rows of stride words, one row per board word), so
+//   that the same word of consecutive entries is contiguous and CanReach
+//   tests a block of entries with a few vector operations.
+class Phase1TableNoTmpl {
+  struct AlignedDelete_ {
+    void operator()(uint64_t* p) const { ::operator delete[](p, std::align_val_t(64)); }
+  };
+
+  int R_;
+  int stride_;
+  Phase1Range initial_;
+  const Phase1Entry* entries_;
+  const uint64_t* masks_;
+  const Phase1Range* adj_;
+  // empty for a baked table
+  std::vector<Phase1Entry> entry_storage_;
+  std::vector<Phase1Range> adj_storage_;
+  std::unique_ptr<uint64_t[], AlignedDelete_> mask_storage_;
+
+ public:
+  Phase1TableNoTmpl(Level level, int R, int adj_frame, const int taps[]) : R_(R) {
+    std::vector<TableEntryNoTmpl> generated(Phase1TableCapacity(R));
+    int bounds[42];
+    int n = Phase1TableFill(level, R, adj_frame, taps, generated.data(), bounds);
+    int capacity = bounds[n + 1];
+    stride_ = Phase1MaskStride(capacity);
+    entry_storage_.resize(capacity);
+    adj_storage_.resize(n);
+    mask_storage_.reset(new (std::align_val_t(64)) uint64_t[stride_ * R * 4]());
+    int sz = Phase1TableCompact(
+        R, generated.data(), bounds, n, entry_storage_.data(), mask_storage_.get(), stride_, adj_storage_.data());
+    entry_storage_.resize(sz);
+    entry_storage_.shrink_to_fit();
+    if (int stride = Phase1MaskStride(sz); stride < stride_) {
+      // most adj tables are shared, so the compacted masks are much smaller
+      std::unique_ptr<uint64_t[], AlignedDelete_> masks(new (std::align_val_t(64)) uint64_t[stride * R * 4]());
+      for (int i = 0; i < R * 4; i++) std::copy_n(mask_storage_.get() + i * stride_, sz, masks.get() + i * stride);
+      mask_storage_ = std::move(masks);
+      stride_ = stride;
+    }
+    initial_ = {0, (uint16_t)n};
+    entries_ = entry_storage_.data();
+    masks_ = mask_storage_.get();
+    adj_ = adj_storage_.data();
+  }
+  // view of a table in static storage (see BakedPhase1Table)
+  constexpr Phase1TableNoTmpl(
+      int R, int num_initial, const Phase1Entry entries[], const uint64_t masks[], int stride,
+      const Phase1Range adj[]) :
+      R_(R), stride_(stride), initial_{0, (uint16_t)num_initial}, entries_(entries), masks_(masks), adj_(adj) {}
+
+  // the pointers refer to heap storage, which is kept when moved
+  Phase1TableNoTmpl(Phase1TableNoTmpl&&) = default;
+  Phase1TableNoTmpl(const Phase1TableNoTmpl&) = delete;
+
+  // memory owned by the table (none for a baked table)
+  size_t HeapBytes() const {
+    return entry_storage_.capacity() * sizeof(Phase1Entry) + adj_storage_.capacity() * sizeof(Phase1Range) +
+        (mask_storage_ ? (size_t)stride_ * R_ * 4 * sizeof(uint64_t) : 0);
+  }
+
+  constexpr Phase1Range Initial() const { return initial_; }
+  // adj table of the i-th initial entry
+  constexpr Phase1Range Adj(int i) const { return adj_[i]; }
+  constexpr const Phase1Entry& Entry(int i) const { return entries_[i]; }
+
+  // Bit i is set if every cell of the masks_nodrop of entry range.begin + i
+  //   is empty in board (range.size <= 10R <= 40). The inner loop over a
+  //   block is written so that the compiler vectorizes it (with AVX2, one
+  //   register holds a word of four entries); SIMD128 is done by hand.
+  template <int R>
+  constexpr uint64_t CanReach(const std::array<Board, R>& board, Phase1Range range) const {
+    uint64_t ret = 0;
+#ifdef __wasm_simd128__
+    if (!std::is_constant_evaluated()) {
+      const v128_t zero = wasm_i64x2_splat(0);
+      for (int base = 0; base < range.size; base += kReachBlock) {
+        v128_t missing[kReachBlock / 2];
+        for (auto& i : missing) i = zero;
+        for (int r = 0; r < R; r++) {
+          const uint64_t words[4] = {board[r].b1, board[r].b2, board[r].b3, board[r].b4};
+          for (int w = 0; w < 4; w++) {
+            const uint64_t* masks = masks_ + (r * 4 + w) * stride_ + range.begin + base;
+            v128_t word = wasm_i64x2_splat(words[w]);
+            for (int j = 0; j < kReachBlock / 2; j++) {
+              missing[j] = wasm_v128_or(missing[j], wasm_v128_andnot(wasm_v128_load(masks + j * 2), word));
+            }
+          }
+        }
+        for (int j = 0; j < kReachBlock / 2; j++) {
+          ret |= (uint64_t)wasm_i64x2_bitmask(wasm_i64x2_eq(missing[j], zero)) << (base + j * 2);
+        }
+      }
+      return ret & ((1ull << range.size) - 1);
+    }
+#endif
+    for (int base = 0; base < range.size; base += kReachBlock) {
+      uint64_t missing[kReachBlock] = {};
+      for (int r = 0; r < R; r++) {
+        const uint64_t words[4] = {board[r].b1, board[r].b2, board[r].b3, board[r].b4};
+        for (int w = 0; w < 4; w++) {
+          const uint64_t* masks = masks_ + (r * 4 + w) * stride_ + range.begin + base;
+          for (int j = 0; j < kReachBlock; j++) missing[j] |= masks[j] & ~words[w];
+        }
+      }
+      for (int j = 0; j < kReachBlock; j++) ret |= (uint64_t)!missing[j] << (base + j);
+    }
+    return ret & ((1ull << range.size) - 1);
+  }
+};
+
+// Phase1TableNoTmpl generated at compile time into read-only static storage
+template <Level level, int R, int adj_frame, std::array<int, 10> taps>
+class BakedPhase1Table {
+  static constexpr int kCapacityStride_ = Phase1MaskStride(Phase1TableCapacity(R));
+  struct Generated_ {
+    std::array<Phase1Entry, Phase1TableCapacity(R)> entries;
+    std::array<uint64_t, kCapacityStride_ * R * 4> masks;
+    std::array<Phase1Range, 10 * R> adj;
+    int num_initial, size;
+  };
+  static constexpr Generated_ kGenerated_ = []() {
+    std::array<TableEntryNoTmpl, Phase1TableCapacity(R)> generated{};
+    std::array<int, 10 * R + 2> bounds{};
+    Generated_ ret{};
+    ret.num_initial = Phase1TableFill(level, R, adj_frame, taps.data(), generated.data(), bounds.data());
+    ret.size = Phase1TableCompact(
+        R, generated.data(), bounds.data(), ret.num_initial, ret.entries.data(),
+        ret.masks.data(), kCapacityStride_, ret.adj.data());
+    return ret;
+  }();
+  static constexpr int kNumInitial_ = kGenerated_.num_initial;
+  static constexpr int kSize_ = kGenerated_.size;
+
+  // only the used part of kGenerated_ ends up in the binary
+  template <class T, size_t N, size_t M>
+  static constexpr std::array<T, N> Prefix_(const std::array<T, M>& x) {
+    std::array<T, N> ret{};
+    for (size_t i = 0; i < N; i++) ret[i] = x[i];
+    return ret;
+  }
+  static constexpr std::array<Phase1Entry, kSize_> kEntries_ =
+      Prefix_<Phase1Entry, kSize_>(kGenerated_.entries);
+  static constexpr int kStride_ = Phase1MaskStride(kSize_);
+  alignas(64) static constexpr std::array<uint64_t, kStride_ * R * 4> kMasks_ = []() {
+    std::array<uint64_t, kStride_ * R * 4> ret{};
+    for (int i = 0; i < R * 4; i++) {
+      for (int j = 0; j < kSize_; j++) ret[i * kStride_ + j] = kGenerated_.masks[i * kCapacityStride_ + j];
     }
+    return ret;
+  }();
+  static constexpr std::array<Phase1Range, kNumInitial_> kAdj_ =
+      Prefix_<Phase1Range, kNumInitial_>(kGenerated_.adj);
+
+ public:
+  static constexpr Phase1TableNoTmpl Get() {
+    return {R, kNumInitial_, kEntries_.data(), kMasks_.data(), kStride_, kAdj_.data()};
   }
 };
 
@@ -244,60 +707,71 @@ struct FrameMasks {
   Frames frame[R][10], drop[R][10];
 };
 
-constexpr Frames ColumnToNormalFrameMask(Level level, Column col) {
-  switch (level) {
-    case kLevel18: {
-      constexpr uint64_t kMask = 0x249249249249249;
-      uint64_t expanded = pdep<uint64_t>(col, kMask);
-      return expanded | expanded << 1 | expanded << 2;
-    }
-    case kLevel19: {
-      constexpr uint64_t kMask = 0x5555555555;
-      uint64_t expanded = pdep<uint64_t>(col, kMask);
-      return expanded | expanded << 1;
-    }
-    case kLevel29: return col;
-    case kLevel39: {
-      constexpr uint32_t kMask = 0x55555;
-      return pext(col, kMask);
-    }
+template <Level level, PextMode mode = kDefaultPextMode>
+constexpr Frames ColumnToNormalFrameMask(Column col) {
+  if constexpr (level == kLevel18) {
+    constexpr uint64_t kMask = 0x249249249249249;
+    uint64_t expanded = pdep<kMask, mode>(col);
+    return expanded | expanded << 1 | expanded << 2;
+  } else if constexpr (level == kLevel19) {
+    constexpr uint64_t kMask = 0x5555555555;
+    uint64_t expanded = pdep<kMask, mode>(col);
+    return expanded | expanded << 1;
+  } else if constexpr (level == kLevel29) {
+    return col;
+  } else {
+    constexpr uint32_t kMask = 0x55555;
+    return pext<kMask, mode>(col);
   }
-  unreachable();
 }
 
-constexpr Frames ColumnToDropFrameMask(Level level, Column col) {
-  switch (level) {
-    case kLevel18: [[fallthrough]];
-    case kLevel19: [[fallthrough]];
-    case kLevel29: {
-      uint64_t mask = ColumnToNormalFrameMask(level, col);
-      return mask & mask >> 1;
-    }
-    case kLevel39: {
-      constexpr uint32_t kMask = 0x55555;
-      return pext(col & col >> 1 & col >> 2, kMask);
-    }
+template <Level level, PextMode mode = kDefaultPextMode>
+constexpr Frames ColumnToDropFrameMask(Column col) {
+  if constexpr (level != kLevel39) {
+    uint64_t mask = ColumnToNormalFrameMask<level, mode>(col);
+    return mask & mask >> 1;
+  } else {
+    constexpr uint32_t kMask = 0x55555;
+    return pext<kMask, mode>(col & col >> 1 & col >> 2);
   }
-  unreachable();
 }
 
-constexpr Column FramesToColumn(Level level, Frames frames) {
-  switch (level) {
-    case kLevel18: {
-      constexpr uint64_t kMask = 0x249249249249249;
-      return pext(frames | frames >> 1 | frames >> 2, kMask);
-    }
-    case kLevel19: {
-      constexpr uint64_t kMask = 0x5555555555;
-      return pext(frames | frames >> 1, kMask);
-    }
-    case kLevel29: return frames;
-    case kLevel39: {
-      constexpr uint32_t kMask = 0x55555;
-      return pdep<uint32_t>(frames, kMask);
-    }
+template <Level level, PextMode mode = kDefaultPextMode>
+constexpr Column FramesToColumn(Frames frames) {
+  if constexpr (level == kLevel18) {
+    constexpr uint64_t kMask = 0x249249249249249;
+    return pext<kMask, mode>(frames | frames >> 1 | frames >> 2);
+  } else if constexpr (level == kLevel19) {
+    constexpr uint64_t kMask = 0x5555555555;
+    return pext<kMask, mode>(frames | frames >> 1);
+  } else if constexpr (level == kLevel29) {
+    return frames;
+  } else {
+    constexpr uint32_t kMask = 0x55555;
+    return pdep<kMask, mode>(frames);
   }
-  unreachable();
+}
+
+// runtime-level versions of the above
+template <PextMode mode = kDefaultPextMode>
+constexpr Frames ColumnToNormalFrameMask(Level level, Column col) {
+#define ONE_CASE(x) case x: return ColumnToNormalFrameMask<x, mode>(col);
+  DO_LEVEL_CASE(level);
+#undef ONE_CASE
+}
+
+template <PextMode mode = kDefaultPextMode>
+constexpr Frames ColumnToDropFrameMask(Level level, Column col) {
+#define ONE_CASE(x) case x: return ColumnToDropFrameMask<x, mode>(col);
+  DO_LEVEL_CASE(level);
+#undef ONE_CASE
+}
+
+template <PextMode mode = kDefaultPextMode>
+constexpr Column FramesToColumn(Level level, Frames frames) {
+#define ONE_CASE(x) case x: return FramesToColumn<x, mode>(frames);
+  DO_LEVEL_CASE(level);
+#undef ONE_CASE
 }
 
 constexpr int FindLockRow(uint32_t col, int start_row) {
@@ -357,13 +831,152 @@ struct TuckTypeTable {
   }
 };
 
+#ifdef __wasm_simd128__
+// SIMD128 versions of the per-column frame mask computations; each vector
+// holds the masks of two adjacent columns
+namespace simd {
+
+// pdep(x, 0x5555555555) for 20-bit x
+inline v128_t Spread2(v128_t x) {
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 16)), wasm_i64x2_splat(0x0000ffff0000ffff));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 8)), wasm_i64x2_splat(0x00ff00ff00ff00ff));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 4)), wasm_i64x2_splat(0x0f0f0f0f0f0f0f0f));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 2)), wasm_i64x2_splat(0x3333333333333333));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 1)), wasm_i64x2_splat(0x5555555555555555));
+  return x;
+}
+
+// pdep(x, 0x249249249249249) for 20-bit x
+inline v128_t Spread3(v128_t x) {
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 32)), wasm_i64x2_splat(0x001f00000000ffff));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 16)), wasm_i64x2_splat(0x001f0000ff0000ff));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 8)), wasm_i64x2_splat(0x100f00f00f00f00f));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 4)), wasm_i64x2_splat(0x10c30c30c30c30c3));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_i64x2_shl(x, 2)), wasm_i64x2_splat(0x1249249249249249));
+  return x;
+}
+
+// pext(x, 0x55555)
+inline v128_t CompactEven(v128_t x) {
+  x = wasm_v128_and(x, wasm_i64x2_splat(0x55555));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_u64x2_shr(x, 1)), wasm_i64x2_splat(0x33333));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_u64x2_shr(x, 2)), wasm_i64x2_splat(0x0f0f0f));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_u64x2_shr(x, 4)), wasm_i64x2_splat(0x00ff00ff));
+  x = wasm_v128_and(wasm_v128_or(x, wasm_u64x2_shr(x, 8)), wasm_i64x2_splat(0x0000ffff));
+  return x;
+}
+
+template <Level level>
+inline void ColumnsToFrameMasks(v128_t col, Frames* frame, Frames* drop) {
+  v128_t normal, dropped;
+  v128_t col20 = wasm_v128_and(col, wasm_i64x2_splat(Board::kColumnMask));
+  if constexpr (level == kLevel18) {
+    v128_t expanded = Spread3(col20);
+    normal = wasm_v128_or(
+        wasm_v128_or(expanded, wasm_i64x2_shl(expanded, 1)), wasm_i64x2_shl(expanded, 2));
+    dropped = wasm_v128_and(normal, wasm_u64x2_shr(normal, 1));
+  } else if constexpr (level == kLevel19) {
+    v128_t expanded = Spread2(col20);
+    normal = wasm_v128_or(expanded, wasm_i64x2_shl(expanded, 1));
+    dropped = wasm_v128_and(normal, wasm_u64x2_shr(normal, 1));
+  } else if constexpr (level == kLevel29) {
+    normal = col;
+    dropped = wasm_v128_and(normal, wasm_u64x2_shr(normal, 1));
+  } else {
+    normal = CompactEven(col);
+    dropped = CompactEven(wasm_v128_and(
+        wasm_v128_and(col, wasm_u64x2_shr(col, 1)), wasm_u64x2_shr(col, 2)));
+  }
+  wasm_v128_store(frame, normal);
+  wasm_v128_store(drop, dropped);
+}
+
+template <int R, Level level>
+FrameMasks<R> GetColsAndFrameMasks(const std::array<Board, R>& board, Column cols[R][10]) {
+  FrameMasks<R> frame_masks;
+  const v128_t kMask = wasm_i64x2_splat(Board::kColumnMask);
+  for (int rot = 0; rot < R; rot++) {
+    v128_t lo = wasm_v128_load(&board[rot].b1), hi = wasm_v128_load(&board[rot].b3);
+    v128_t c03 = wasm_v128_and(lo, kMask);
+    v128_t c14 = wasm_v128_and(wasm_u64x2_shr(lo, 22), kMask);
+    v128_t c25 = wasm_v128_and(wasm_u64x2_shr(lo, 44), kMask);
+    // Column(9) returns b4 as-is
+    v128_t c69 = wasm_v128_and(hi, wasm_i64x2_const(Board::kColumnMask, 0xffffffff));
+    v128_t c78 = wasm_i64x2_shuffle(
+        wasm_v128_and(wasm_u64x2_shr(hi, 22), kMask), wasm_v128_and(wasm_u64x2_shr(hi, 44), kMask), 0, 2);
+    v128_t pairs[5] = {
+      wasm_i64x2_shuffle(c03, c14, 0, 2),
+      wasm_i64x2_shuffle(c25, c03, 0, 3),
+      wasm_i64x2_shuffle(c14, c25, 1, 3),
+      wasm_i64x2_shuffle(c69, c78, 0, 2),
+      wasm_i64x2_shuffle(c78, c69, 1, 3),
+    };
+    for (int i = 0; i < 5; i++) {
+      cols[rot][i * 2] = wasm_i64x2_extract_lane(pairs[i], 0);
+      cols[rot][i * 2 + 1] = wasm_i64x2_extract_lane(pairs[i], 1);
+      ColumnsToFrameMasks<level>(pairs[i], frame_masks.frame[rot] + i * 2, frame_masks.drop[rot] + i * 2);
+    }
+  }
+  return frame_masks;
+}
+
 template <int R>
-constexpr TuckMasks<R> GetTuckMasks(const FrameMasks<R> m) {
-  TuckMasks<R> ret{};
+TuckMasks<R> GetTuckMasks(const FrameMasks<R>& m) {
+  // pad two empty columns on each side so that neighbour loads stay in range
+  //   and read zero, which matches the column bounds checks of the scalar version
+  Frames frame[R][14] = {}, drop[R][14] = {};
+  for (int rot = 0; rot < R; rot++) {
+    std::copy(m.frame[rot], m.frame[rot] + 10, frame[rot] + 2);
+    std::copy(m.drop[rot], m.drop[rot] + 10, drop[rot] + 2);
+  }
+  auto F = [&](int rot, int col) { return wasm_v128_load(frame[rot] + col + 2); };
+  auto D = [&](int rot, int col) { return wasm_v128_load(drop[rot] + col + 2); };
+  auto And = [](v128_t a, v128_t b) { return wasm_v128_and(a, b); };
+
+  TuckMasks<R> ret;
+  constexpr int x = kDoubleTuckAllowed ? 2 : 0;
+  auto Store = [&](int type, int rot, int col, v128_t v) { wasm_v128_store(ret[type][rot].data() + col, v); };
+  auto StoreSpins = [&](int base, int rot, int nrot, int col, v128_t tl, v128_t tr) {
+    v128_t cur = F(rot, col);
+    Store(base, rot, col, And(cur, F(nrot, col)));
+    Store(base + 1, rot, col, And(tl, F(nrot, col - 1)));
+    Store(base + 2, rot, col, And(tr, F(nrot, col + 1)));
+    Store(base + 3, rot, col, And(And(cur, wasm_v128_or(D(nrot, col), D(rot, col - 1))),
+                                  wasm_u64x2_shr(F(nrot, col - 1), 1)));
+    Store(base + 4, rot, col, And(And(cur, wasm_v128_or(D(nrot, col), D(rot, col + 1))),
+                                  wasm_u64x2_shr(F(nrot, col + 1), 1)));
+  };
+  for (int rot = 0; rot < R; rot++) {
+    for (int col = 0; col < 10; col += 2) {
+      v128_t cur = F(rot, col);
+      v128_t tl = And(cur, F(rot, col - 1));
+      v128_t tr = And(cur, F(rot, col + 1));
+      Store(0, rot, col, tl);
+      Store(1, rot, col, tr);
+#ifdef DOUBLE_TUCK
+      Store(2, rot, col, And(And(cur, D(rot, col - 1)),
+                             And(wasm_u64x2_shr(D(rot, col - 1), 1), wasm_u64x2_shr(F(rot, col - 2), 2))));
+      Store(3, rot, col, And(And(cur, D(rot, col + 1)),
+                             And(wasm_u64x2_shr(D(rot, col + 1), 1), wasm_u64x2_shr(F(rot, col + 2), 2))));
+#endif
+      if constexpr (R >= 2) StoreSpins(x + 2, rot, (rot + 1) % R, col, tl, tr);
+      if constexpr (R == 4) StoreSpins(x + 7, rot, (rot + 3) % R, col, tl, tr);
+    }
+  }
+  return ret;
+}
+
+} // namespace simd
+#endif
+
+// recompute the tuck masks starting from columns [col_begin, col_end); the
+//   masks that would start out of the board are left as they are (zero)
+template <int R>
+constexpr void UpdateTuckMasks(const FrameMasks<R>& m, int col_begin, int col_end, TuckMasks<R>& ret) {
   constexpr int x = kDoubleTuckAllowed ? 2 : 0;
 #pragma GCC unroll 4
   for (int rot = 0; rot < R; rot++) {
-    for (int col = 0; col < 10; col++) {
+    for (int col = col_begin; col < col_end; col++) {
       if (col > 0) ret[0][rot][col] = m.frame[rot][col] & m.frame[rot][col-1];
       if (col < 9) ret[1][rot][col] = m.frame[rot][col] & m.frame[rot][col+1];
 #ifdef DOUBLE_TUCK
@@ -372,11 +985,11 @@ constexpr TuckMasks<R> GetTuckMasks(const FrameMasks<R> m) {
 #endif
     }
   }
-  if (R == 1) return ret;
+  if (R == 1) return;
 #pragma GCC unroll 4
   for (int rot = 0; rot < R; rot++) {
     int nrot = (rot + 1) % R;
-    for (int col = 0; col < 10; col++) {
+    for (int col = col_begin; col < col_end; col++) {
       ret[x+2][rot][col] = m.frame[rot][col] & m.frame[nrot][col];
       if (col > 0) ret[x+3][rot][col] = ret[0][rot][col] & m.frame[nrot][col-1];
       if (col < 9) ret[x+4][rot][col] = ret[1][rot][col] & m.frame[nrot][col+1];
@@ -384,11 +997,11 @@ constexpr TuckMasks<R> GetTuckMasks(const FrameMasks<R> m) {
       if (col < 9) ret[x+6][rot][col] = m.frame[rot][col] & (m.drop[nrot][col] | m.drop[rot][col+1]) & m.frame[nrot][col+1] >> 1;
     }
   }
-  if (R == 2) return ret;
+  if (R == 2) return;
 #pragma GCC unroll 4
   for (int rot = 0; rot < R; rot++) {
     int nrot = (rot + 3) % R;
-    for (int col = 0; col < 10; col++) {
+    for (int col = col_begin; col < col_end; col++) {
       ret[x+7][rot][col] = m.frame[rot][col] & m.frame[nrot][col];
       if (col > 0) ret[x+8][rot][col] = ret[0][rot][col] & m.frame[nrot][col-1];
       if (col < 9) ret[x+9][rot][col] = ret[1][rot][col] & m.frame[nrot][col+1];
@@ -396,18 +1009,77 @@ constexpr TuckMasks<R> GetTuckMasks(const FrameMasks<R> m) {
       if (col < 9) ret[x+11][rot][col] = m.frame[rot][col] & (m.drop[nrot][col] | m.drop[rot][col+1]) & m.frame[nrot][col+1] >> 1;
     }
   }
+}
+
+template <int R>
+constexpr TuckMasks<R> GetTuckMasks(const FrameMasks<R>& m) {
+#ifdef __wasm_simd128__
+  if (!std::is_constant_evaluated()) return simd::GetTuckMasks<R>(m);
+#endif
+  TuckMasks<R> ret{};
+  UpdateTuckMasks<R>(m, 0, 10, ret);
   return ret;
 }
 
+// The masks of a board that the search uses, kept between searches so that
+//   after a small edit only the changed columns have to be redone
+template <int R>
+struct SearchMasks {
+  int level = -1; // that the masks belong to; -1 if not computed
+  Column cols[R][10];
+  FrameMasks<R> frame_masks;
+  // the tuck masks are computed when a tuck search first needs them (see
+  //   EnsureTuckMasks); only the ones starting from the columns in tuck_cols
+  //   are up to date
+  uint32_t tuck_cols = 0;
+  TuckMasks<R> tuck_masks;
+};
+
+// Compute the tuck masks that are not up to date. This is done for all columns
+//   at once: computing only the ones a tuck search reads costs more in
+//   bookkeeping than it saves.
 template <int R>
-NOINLINE constexpr void SearchTucks(
-    Level level,
-    const Column cols[R][10],
-    const TuckMasks<R> tuck_masks,
+void EnsureTuckMasks(SearchMasks<R>& m) {
+  uint32_t missing = ~m.tuck_cols & 0x3ff;
+  if (!missing) return;
+  if (missing == 0x3ff) {
+    m.tuck_masks = GetTuckMasks<R>(m.frame_masks);
+  } else {
+    while (missing) {
+      int begin = ctz(missing), end = begin;
+      while (missing >> end & 1) end++;
+      UpdateTuckMasks<R>(m.frame_masks, begin, end, m.tuck_masks);
+      missing &= ~0u << end;
+    }
+  }
+  m.tuck_cols = 0x3ff;
+}
+
+template <int R, Level level, PextMode mode, class Output>
+constexpr void SearchTucks(
+    SearchMasks<R>& masks,
     const Column lock_positions_without_tuck[R][10],
     const Frames can_tuck_frame_masks[R][10],
-    int& sz, Position* positions) {
+    Output& out) {
   constexpr TuckTypeTable<R> tucks;
+  const auto& cols = masks.cols;
+  const auto& tuck_masks = masks.tuck_masks;
+  // A piece locks at the bottom of an empty run (cur & ~cur >> 1), so a tuck
+  //   only adds positions at the bottoms that were not reached without tuck.
+  //   Besides the topmost run, these are under overhangs; on a clean stack
+  //   there are usually none, and the tucks need not be searched.
+  Column new_lock_rows[R][10];
+  Column any_new_lock_row = 0;
+  for (int rot = 0; rot < R; rot++) {
+    for (int col = 0; col < 10; col++) {
+      Column cur = cols[rot][col];
+      new_lock_rows[rot][col] = cur & ~cur >> 1 & ~lock_positions_without_tuck[rot][col];
+      any_new_lock_row |= new_lock_rows[rot][col];
+    }
+  }
+  if (!any_new_lock_row) return;
+  EnsureTuckMasks<R>(masks);
+
   Frames tuck_result[R][10] = {};
   for (int i = 0; i < TuckTypes(R); i++) {
     const auto& tuck = tucks.table[i];
@@ -423,25 +1095,44 @@ NOINLINE constexpr void SearchTucks(
   }
   for (int rot = 0; rot < R; rot++) {
     for (int col = 0; col < 10; col++) {
-      Column after_tuck_positions = FramesToColumn(level, tuck_result[rot][col]);
-      Column cur = cols[rot][col];
-      Column tuck_lock_positions = (after_tuck_positions + cur) >> 1 & (cur & ~cur >> 1) & ~lock_positions_without_tuck[rot][col];
-      while (tuck_lock_positions) {
-        int row = ctz(tuck_lock_positions);
-        positions[sz++] = {rot, row, col};
-        tuck_lock_positions ^= 1 << row;
-      }
+      if (!new_lock_rows[rot][col]) continue;
+      Column after_tuck_positions = FramesToColumn<level, mode>(tuck_result[rot][col]);
+      Column tuck_lock_positions = (after_tuck_positions + cols[rot][col]) >> 1 & new_lock_rows[rot][col];
+      out.AddColumn(rot, col, tuck_lock_positions);
     }
   }
 }
 
-template <int R, class Tap, class Entry>
+// SearchTucks is kept out of line so that DoOneSearch stays small. flatten
+//   does not inline across it, so the hardware pext version enables BMI2 by
+//   itself instead of relying on MoveSearchHardwarePext.
+template <int R, Level level, PextMode mode, class Output>
+NOINLINE void SearchTucksOutOfLine(
+    SearchMasks<R>& masks,
+    const Column lock_positions_without_tuck[R][10],
+    const Frames can_tuck_frame_masks[R][10],
+    Output& out) {
+  SearchTucks<R, level, mode>(masks, lock_positions_without_tuck, can_tuck_frame_masks, out);
+}
+
+#ifdef HAS_BMI2_PATH
+template <int R, Level level, class Output>
+TARGET_BMI2 NOINLINE __attribute__((flatten)) void SearchTucksHardwarePext(
+    SearchMasks<R>& masks,
+    const Column lock_positions_without_tuck[R][10],
+    const Frames can_tuck_frame_masks[R][10],
+    Output& out) {
+  SearchTucks<R, level, PextMode::kHardware>(masks, lock_positions_without_tuck, can_tuck_frame_masks, out);
+}
+#endif
+
+template <int R, Level level, class Tap, class Entry, class Output>
 constexpr void CheckOneInitial(
-    Level level, int adj_frame, const Tap& taps, bool is_adj,
+    int adj_frame, const Tap& taps, bool is_adj,
     int total_frames, int initial_frame, const Entry& entry, const Column cols[R][10],
     Column lock_positions_without_tuck[R][10],
     Frames can_tuck_frame_masks[R][10],
-    int& sz, Position* positions,
+    Output& out,
     bool& can_adj, bool& phase_2_possible) {
   int start_frame = (entry.num_taps == 0 ? 0 : taps[entry.num_taps - 1]) + initial_frame;
   int start_row = GetRow(start_frame, level);
@@ -453,7 +1144,7 @@ constexpr void CheckOneInitial(
   if (!is_adj && lock_frame > end_frame) {
     can_adj = true;
   } else {
-    positions[sz++] = {entry.rot, lock_row, entry.col};
+    out.Add(entry.rot, lock_row, entry.col);
   }
   int first_tuck_frame = initial_frame + taps[entry.num_taps];
   int last_tuck_frame = std::min(lock_frame, end_frame);
@@ -464,98 +1155,187 @@ constexpr void CheckOneInitial(
   }
 }
 
-template <int R>
-constexpr FrameMasks<R> GetColsAndFrameMasks(Level level, const std::array<Board, R>& board, Column cols[R][10]) {
+template <int R, Level level, PextMode mode = kDefaultPextMode>
+constexpr FrameMasks<R> GetColsAndFrameMasks(const std::array<Board, R>& board, Column cols[R][10]) {
+#ifdef __wasm_simd128__
+  if (!std::is_constant_evaluated()) return simd::GetColsAndFrameMasks<R, level>(board, cols);
+#endif
   FrameMasks<R> frame_masks = {};
   for (int rot = 0; rot < R; rot++) {
     for (int col = 0; col < 10; col++) {
       cols[rot][col] = board[rot].Column(col);
-      // ColumnToNormalFrameMask<level>(col), ColumnToDropFrameMask<level>(col)
-      frame_masks.frame[rot][col] = ColumnToNormalFrameMask(level, cols[rot][col]);
-      frame_masks.drop[rot][col] = ColumnToDropFrameMask(level, cols[rot][col]);
+      frame_masks.frame[rot][col] = ColumnToNormalFrameMask<level, mode>(cols[rot][col]);
+      frame_masks.drop[rot][col] = ColumnToDropFrameMask<level, mode>(cols[rot][col]);
     }
   }
   return frame_masks;
 }
 
-template <int R>
-int DoOneSearch(
-    bool is_adj, int initial_taps, Level level, int adj_frame, const int taps[],
-    const std::vector<TableEntryNoTmpl>& table,
-    const std::array<Board, R>& board, const Column cols[R][10],
-    const TuckMasks<R> tuck_masks,
+template <int R, Level level, PextMode mode = kDefaultPextMode>
+void UpdateSearchMasks(const std::array<Board, R>& board, SearchMasks<R>& m) {
+  // beyond this many changed columns, recomputing everything is cheaper
+  constexpr int kMaxDirtyColumns = 4;
+  uint32_t dirty = 0;
+  if (m.level == level) {
+    for (int rot = 0; rot < R; rot++) {
+      for (int col = 0; col < 10; col++) {
+        if (board[rot].Column(col) != m.cols[rot][col]) dirty |= 1 << col;
+      }
+    }
+    if (!dirty) return;
+  }
+  if (m.level != level || popcount(dirty) > kMaxDirtyColumns) {
+    m.level = level;
+    m.frame_masks = GetColsAndFrameMasks<R, level, mode>(board, m.cols);
+    m.tuck_cols = 0;
+    return;
+  }
+  for (uint32_t x = dirty; x; x &= x - 1) {
+    int col = ctz(x);
+    for (int rot = 0; rot < R; rot++) {
+      m.cols[rot][col] = board[rot].Column(col);
+      m.frame_masks.frame[rot][col] = ColumnToNormalFrameMask<level, mode>(m.cols[rot][col]);
+      m.frame_masks.drop[rot][col] = ColumnToDropFrameMask<level, mode>(m.cols[rot][col]);
+    }
+  }
+  // tucks reach up to two columns away (double tucks), in any rotation
+  m.tuck_cols &= ~(dirty | dirty << 1 | dirty << 2 | dirty >> 1 | dirty >> 2);
+}
+
+// adds the found positions to out, which should be empty
+template <int R, Level level, PextMode mode, class Output>
+void DoOneSearch(
+    bool is_adj, int initial_taps, int adj_frame, const int taps[],
+    const Phase1TableNoTmpl& table, Phase1Range range,
+    const std::array<Board, R>& board, SearchMasks<R>& masks,
     bool can_adj[],
-    Position* positions) {
+    Output& out) {
+  const auto& cols = masks.cols;
   int total_frames = GetLastFrameOnRow(19, level) + 1;
-  int N = table.size();
+  int N = range.size;
   int initial_frame = is_adj ? std::max(adj_frame, taps[initial_taps]) : 0;
-  if (initial_frame >= total_frames) return 0;
+  if (initial_frame >= total_frames) return;
 
-  int sz = 0;
   // phase 1
   Frames can_tuck_frame_masks[R][10] = {}; // frames that can start a tuck
   Column lock_positions_without_tuck[R][10] = {};
 
   bool phase_2_possible = false;
-  bool can_reach[R * 10] = {};
-  for (int i = 0; i < N; i++) {
-    can_reach[i] = Contains4<R>(board, table[i].masks_nodrop);
-  }
+  uint64_t can_reach = table.CanReach<R>(board, range);
   for (int i = 0; i < N; i++) {
-    if (!can_reach[i]) continue;
-    CheckOneInitial<R>(
-        level, adj_frame, taps, is_adj, total_frames, initial_frame, table[i], cols,
+    if (!(can_reach >> i & 1)) continue;
+    CheckOneInitial<R, level>(
+        adj_frame, taps, is_adj, total_frames, initial_frame, table.Entry(range.begin + i), cols,
         lock_positions_without_tuck, can_tuck_frame_masks,
-        sz, positions, can_adj[i], phase_2_possible);
+        out, can_adj[i], phase_2_possible);
   }
-  if (phase_2_possible) {
-    SearchTucks<R>(level, cols, tuck_masks, lock_positions_without_tuck, can_tuck_frame_masks, sz, positions);
+  if (!phase_2_possible) return;
+#ifdef HAS_BMI2_PATH
+  if constexpr (mode == PextMode::kHardware) {
+    SearchTucksHardwarePext<R, level>(masks, lock_positions_without_tuck, can_tuck_frame_masks, out);
+  } else
+#endif
+  {
+    SearchTucksOutOfLine<R, level, mode>(masks, lock_positions_without_tuck, can_tuck_frame_masks, out);
   }
-  return sz;
 }
 
-template <int R>
-inline PossibleMoves MoveSearchInternal(
-    Level level, int adj_frame, const int taps[], const Phase1TableNoTmpl& table,
-    const std::array<Board, R>& board) {
-  Column cols[R][10] = {};
-  auto tuck_masks = GetTuckMasks<R>(GetColsAndFrameMasks<R>(level, board, cols));
-  bool can_adj[R * 10] = {}; // whether adjustment starting from this (rot, col) is possible
+// Moves is PossibleMoves, CompactPossibleMoves or BitboardPossibleMoves
+// Search with n tap tables: ret[i] is the result with taps[i] and tables(i),
+//   which returns a Phase1TableNoTmpl for R. The column and tuck masks depend
+//   only on the board and the level, so they are computed once for all.
+// If cache is given, the masks of the board are updated in it (see
+//   UpdateSearchMasks) instead of computed from scratch.
+template <int R, Level level, PextMode mode, class Moves, class Tables>
+inline void MoveSearchInternal(
+    int adj_frame, int n, const int* const taps[], const Tables& tables,
+    const std::array<Board, R>& board, Moves ret[], SearchMasks<R>* cache) {
+  SearchMasks<R> local;
+  SearchMasks<R>& masks = cache ? *cache : local;
+  UpdateSearchMasks<R, level, mode>(board, masks);
 
-  PossibleMoves ret;
-  Position buf[256];
-  ret.non_adj.assign(buf, buf + DoOneSearch<R>(
-      false, 0, level, adj_frame, taps, table.initial, board, cols, tuck_masks, can_adj, buf));
+  typename Moves::template Output<R> out;
+  for (int t = 0; t < n; t++) {
+    const Phase1TableNoTmpl& table = tables(t);
+    bool can_adj[R * 10] = {}; // whether adjustment starting from this (rot, col) is possible
+    out.Clear();
+    DoOneSearch<R, level, mode>(
+        false, 0, adj_frame, taps[t], table, table.Initial(), board, masks, can_adj, out);
+    ret[t].SetNonAdj(out);
 
-  for (size_t i = 0; i < table.initial.size(); i++) {
-    auto& entry = table.initial[i];
-    if (!can_adj[i]) continue;
-    int x = DoOneSearch<R>(
-        true, entry.num_taps, level, adj_frame, taps, table.adj[i], board, cols, tuck_masks, can_adj, buf);
-    if (x) {
-      int row = GetRow(std::max(adj_frame, taps[entry.num_taps]), level);
-      ret.adj.emplace_back(Position{entry.rot, row, entry.col}, std::vector<Position>(buf, buf + x));
+    for (int i = 0; i < table.Initial().size; i++) {
+      auto& entry = table.Entry(i);
+      if (!can_adj[i]) continue;
+      out.Clear();
+      DoOneSearch<R, level, mode>(
+          true, entry.num_taps, adj_frame, taps[t], table, table.Adj(i), board, masks, can_adj, out);
+      if (!out.empty()) {
+        int row = GetRow(std::max(adj_frame, taps[t][entry.num_taps]), level);
+        ret[t].AddAdj(Position{entry.rot, row, entry.col}, out);
+      }
     }
   }
-  return ret;
+}
+
+// the level is a template parameter of the search so that all frame and row
+//   arithmetic is specialized; dispatch on it once here
+template <int R, PextMode mode, class Moves, class Tables>
+inline void MoveSearchLevel(
+    Level level, int adj_frame, int n, const int* const taps[], const Tables& tables,
+    const std::array<Board, R>& board, Moves ret[], SearchMasks<R>* cache) {
+#define ONE_CASE(x) case x: return MoveSearchInternal<R, x, mode>(adj_frame, n, taps, tables, board, ret, cache);
+  DO_LEVEL_CASE(level);
+#undef ONE_CASE
 }
 
 } // namespace move_search
 
 using PrecomputedTable = move_search::Phase1TableNoTmpl;
 
+#ifdef HAS_BMI2_PATH
+// flatten so that the whole search is compiled with BMI2 enabled
+template <int R, class Moves, class Tables>
+TARGET_BMI2 __attribute__((flatten)) void MoveSearchHardwarePext(
+    Level level, int adj_frame, int n, const int* const taps[], const Tables& tables,
+    const std::array<Board, R>& board, Moves ret[], move_search::SearchMasks<R>* cache) {
+  move_search::MoveSearchLevel<R, PextMode::kHardware>(level, adj_frame, n, taps, tables, board, ret, cache);
+}
+#endif
+
+template <int R, class Moves, class Tables>
+NOINLINE void MoveSearchTaps(
+    Level level, int adj_frame, int n, const int* const taps[], const Tables& tables,
+    const std::array<Board, R>& board, Moves ret[], move_search::SearchMasks<R>* cache = nullptr) {
+#ifdef HAS_BMI2_PATH
+  if (HardwarePextIsFast()) return MoveSearchHardwarePext<R>(level, adj_frame, n, taps, tables, board, ret, cache);
+#endif
+  move_search::MoveSearchLevel<R, PextMode::kSoftware>(level, adj_frame, n, taps, tables, board, ret, cache);
+}
+
+template <int R, class Moves>
+void MoveSearch(
+    Level level, int adj_frame, const int taps[], const PrecomputedTable& table,
+    const std::array<Board, R>& board, Moves& ret) {
+  MoveSearchTaps<R>(level, adj_frame, 1, &taps, [&](int) -> const PrecomputedTable& { return table; }, board, &ret);
+}
+
 template <int R>
-NOINLINE PossibleMoves MoveSearch(
+PossibleMoves MoveSearch(
     Level level, int adj_frame, const int taps[], const PrecomputedTable& table,
     const std::array<Board, R>& board) {
-  return move_search::MoveSearchInternal<R>(level, adj_frame, taps, table, board);
+  PossibleMoves ret;
+  MoveSearch<R>(level, adj_frame, taps, table, board, ret);
+  return ret;
 }
 
 class PrecomputedTableTuple {
   const PrecomputedTable tables[3];
  public:
-  constexpr PrecomputedTableTuple(Level level, int adj_frame, const int taps[]) :
+  PrecomputedTableTuple(Level level, int adj_frame, const int taps[]) :
       tables{{level, 1, adj_frame, taps}, {level, 2, adj_frame, taps}, {level, 4, adj_frame, taps}} {}
+  // tables for R = 1, 2, 4
+  PrecomputedTableTuple(PrecomputedTable&& t1, PrecomputedTable&& t2, PrecomputedTable&& t4) :
+      tables{std::move(t1), std::move(t2), std::move(t4)} {}
   const PrecomputedTable& operator[](int R) const {
     switch (R) {
       case 1: return tables[0];
@@ -563,13 +1343,95 @@ class PrecomputedTableTuple {
       default: return tables[2];
     }
   }
+  size_t HeapBytes() const { return tables[0].HeapBytes() + tables[1].HeapBytes() + tables[2].HeapBytes(); }
 };
 
+template <class Moves>
+void MoveSearch(
+    Level level, int adj_frame, const int taps[], const PrecomputedTableTuple& table,
+    const Board& b, int piece, Moves& ret) {
+#define ONE_CASE(x) \
+    case x: return MoveSearch<Board::NumRotations(x)>( \
+        level, adj_frame, taps, table[Board::NumRotations(x)], b.PieceMap<x>(), ret);
+  DO_PIECE_CASE(piece);
+#undef ONE_CASE
+}
+
 inline PossibleMoves MoveSearch(
     Level level, int adj_frame, const int taps[], const PrecomputedTableTuple& table,
     const Board& b, int piece) {
+  PossibleMoves ret;
+  MoveSearch(level, adj_frame, taps, table, b, piece, ret);
+  return ret;
+}
+
+// search every piece on the same board (ret[piece] is the result of piece);
+//   the piece maps are computed together by Board::GetAllPieceMaps
+template <class Moves>
+void MoveSearchAllPieces(
+    Level level, int adj_frame, const int taps[], const PrecomputedTableTuple& table,
+    const Board& b, std::array<Moves, kPieces>& ret) {
+  auto maps = b.GetAllPieceMaps();
+  [&]<size_t... piece>(std::index_sequence<piece...>) {
+    (MoveSearch<Board::NumRotations(piece)>(
+        level, adj_frame, taps, table[Board::NumRotations(piece)], std::get<piece>(maps), ret[piece]), ...);
+  }(std::make_index_sequence<kPieces>{});
+}
+
+inline std::array<PossibleMoves, kPieces> MoveSearchAllPieces(
+    Level level, int adj_frame, const int taps[], const PrecomputedTableTuple& table,
+    const Board& b) {
+  std::array<PossibleMoves, kPieces> ret;
+  MoveSearchAllPieces(level, adj_frame, taps, table, b, ret);
+  return ret;
+}
+
+// Searches of a board that changes a few cells at a time, as in the board
+//   editor. The masks of the last board searched with each piece are kept, and
+//   only the columns that changed since (and the tuck masks next to them, when
+//   a tuck search needs them) are recomputed; see move_search::UpdateSearchMasks.
+class MoveSearchContext {
+  template <size_t... piece>
+  static auto MakeMasks_(std::index_sequence<piece...>) ->
+      std::tuple<move_search::SearchMasks<Board::NumRotations(piece)>...>;
+  decltype(MakeMasks_(std::make_index_sequence<kPieces>())) masks_;
+
+ public:
+  template <class Moves>
+  void Search(
+      Level level, int adj_frame, const int taps[], const PrecomputedTableTuple& table,
+      const Board& b, int piece, Moves& ret) {
 #define ONE_CASE(x) \
-    case x: return MoveSearch<Board::NumRotations(x)>(level, adj_frame, taps, table[Board::NumRotations(x)], b.PieceMap<x>());
+    case x: { \
+      constexpr int R = Board::NumRotations(x); \
+      return MoveSearchTaps<R>(level, adj_frame, 1, &taps, \
+          [&](int) -> const PrecomputedTable& { return table[R]; }, b.PieceMap<x>(), &ret, &std::get<x>(masks_)); \
+    }
+    DO_PIECE_CASE(piece);
+#undef ONE_CASE
+  }
+
+  PossibleMoves Search(
+      Level level, int adj_frame, const int taps[], const PrecomputedTableTuple& table,
+      const Board& b, int piece) {
+    PossibleMoves ret;
+    Search(level, adj_frame, taps, table, b, piece, ret);
+    return ret;
+  }
+};
+
+// Search one board and piece at one level with n tap tables (see
+//   move_search::MoveSearchInternal); tables[i] belongs to taps[i]
+template <class Moves>
+void MoveSearchTaps(
+    Level level, int adj_frame, int n, const int* const taps[], const PrecomputedTableTuple* const tables[],
+    const Board& b, int piece, Moves ret[]) {
+#define ONE_CASE(x) \
+    case x: { \
+      constexpr int R = Board::NumRotations(x); \
+      return MoveSearchTaps<R>(level, adj_frame, n, taps, \
+          [&](int i) -> const PrecomputedTable& { return (*tables[i])[R]; }, b.PieceMap<x>(), ret); \
+    }
   DO_PIECE_CASE(piece);
 #undef ONE_CASE
 }
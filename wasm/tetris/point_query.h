@@ -0,0 +1,193 @@
+#pragma once
+
+// Whether single placements are reachable, without running the whole search.
+// Only the Phase1 entries that can end at the target are checked, with the
+//   same lock and tuck rules as CheckOneInitial / SearchTucks, so the answer
+//   agrees with MoveSearch.
+
+#include "move_search_no_tmpl.h"
+
+struct PlacementQuery {
+  Position target;
+  // the premove of an adjustment, or Position::Invalid for a placement
+  //   without adjustment (as in PossibleMoves)
+  Position premove = Position::Invalid;
+};
+
+struct PlacementCheck {
+  bool reachable;
+  int num_taps; // inputs needed, counting a tap that shifts and rotates as two
+  int tuck_type; // index in move_search::TuckTypeTable, or -1 if no tuck is needed
+};
+
+namespace move_search {
+
+// inputs from (base_rot, base_col) to the entry; B counts as one rotation
+template <int R>
+constexpr int InputCount(const Phase1Entry& entry, int base_rot, int base_col) {
+  int num_rot = (entry.rot - base_rot + R) % R;
+  return abs(entry.col - base_col) + (num_rot == 3 ? 1 : num_rot);
+}
+
+// Check the entries of range for the target, keeping the way with the fewest
+//   inputs in ret; can_reach is table.CanReach of range and base_rot/base_col
+//   is where the table starts
+template <int R, Level level, PextMode mode>
+void CheckTarget(
+    bool is_adj, int initial_taps, int adj_frame, const int taps[],
+    const Phase1TableNoTmpl& table, Phase1Range range,
+    uint64_t can_reach, const SearchMasks<R>& m,
+    int base_rot, int base_col, const Position& target, PlacementCheck& ret) {
+  constexpr TuckTypeTable<R> tucks;
+  int total_frames = GetLastFrameOnRow(19, level) + 1;
+  int initial_frame = is_adj ? std::max(adj_frame, taps[initial_taps]) : 0;
+  if (initial_frame >= total_frames) return;
+
+  Column target_col = m.cols[target.r][target.y];
+  auto Update = [&](int num_taps, int tuck_type) {
+    if (ret.reachable && ret.num_taps <= num_taps) return;
+    ret = {true, num_taps, tuck_type};
+  };
+  // as in SearchTucks, a tuck does not count if the row is a lock row without
+  //   tuck, even if that one is not placed (because it can still adjust)
+  bool lock_without_tuck = false;
+  uint32_t tuck_types[R * 10] = {}; // the tuck types from each entry to the target
+  for (int i = 0; i < range.size; i++) {
+    const Phase1Entry& entry = table.Entry(range.begin + i);
+    for (int j = 0; j < TuckTypes(R); j++) {
+      const auto& tuck = tucks.table[j];
+      if ((entry.rot + tuck.delta_rot) % R == target.r && entry.col + tuck.delta_col == target.y) tuck_types[i] |= 1 << j;
+    }
+    bool direct = entry.rot == target.r && entry.col == target.y;
+    if (!direct && !tuck_types[i]) continue;
+    if (!(can_reach >> i & 1)) {
+      tuck_types[i] = 0;
+      continue;
+    }
+    if (!direct) continue;
+    int start_frame = (entry.num_taps == 0 ? 0 : taps[entry.num_taps - 1]) + initial_frame;
+    int end_frame = is_adj ? total_frames : std::max(adj_frame, taps[entry.num_taps]);
+    int lock_row = FindLockRow(target_col, GetRow(start_frame, level));
+    if (lock_row != target.x) continue;
+    lock_without_tuck = true;
+    if (is_adj || GetLastFrameOnRow(lock_row, level) + 1 <= end_frame) Update(InputCount<R>(entry, base_rot, base_col), -1);
+  }
+  if (lock_without_tuck) return;
+
+  for (int i = 0; i < range.size; i++) {
+    if (!tuck_types[i]) continue;
+    const Phase1Entry& entry = table.Entry(range.begin + i);
+    int start_frame = (entry.num_taps == 0 ? 0 : taps[entry.num_taps - 1]) + initial_frame;
+    int end_frame = is_adj ? total_frames : std::max(adj_frame, taps[entry.num_taps]);
+    int lock_row = FindLockRow(m.cols[entry.rot][entry.col], GetRow(start_frame, level));
+    int first_tuck_frame = initial_frame + taps[entry.num_taps];
+    int last_tuck_frame = std::min(GetLastFrameOnRow(lock_row, level) + 1, end_frame);
+    if (last_tuck_frame <= first_tuck_frame) continue;
+    Frames can_tuck = (1ll << last_tuck_frame) - (1ll << first_tuck_frame);
+    for (uint32_t types = tuck_types[i]; types; types &= types - 1) {
+      int j = ctz(types);
+      const auto& tuck = tucks.table[j];
+      Frames frames = m.tuck_masks[j][entry.rot][entry.col] & can_tuck;
+      if (!frames) continue;
+      Column after_tuck = FramesToColumn<level, mode>(frames << tuck.delta_frame);
+      Column lock_rows = (after_tuck + target_col) >> 1 & (target_col & ~target_col >> 1);
+      if (!(lock_rows >> target.x & 1)) continue;
+      Update(InputCount<R>(entry, base_rot, base_col) + abs(tuck.delta_col) + (tuck.delta_rot ? 1 : 0), j);
+    }
+  }
+}
+
+template <int R, Level level, PextMode mode>
+void IsReachableInternal(
+    int adj_frame, const int taps[], const Phase1TableNoTmpl& table, const std::array<Board, R>& board,
+    int n, const PlacementQuery queries[], PlacementCheck ret[]) {
+  SearchMasks<R> m;
+  UpdateSearchMasks<R, level, mode>(board, m);
+  EnsureTuckMasks<R>(m);
+  uint64_t initial_reach = table.CanReach<R>(board, table.Initial());
+  // CanReach of the adj tables, filled when first needed
+  uint64_t adj_reach[10 * R];
+  uint64_t adj_done = 0;
+  for (int q = 0; q < n; q++) {
+    const Position& target = queries[q].target;
+    const Position& premove = queries[q].premove;
+    ret[q] = {false, 0, -1};
+    if (target.r < 0 || target.r >= R || target.x < 0 || target.x >= 20 || target.y < 0 || target.y >= 10) continue;
+    if (premove == Position::Invalid) {
+      CheckTarget<R, level, mode>(
+          false, 0, adj_frame, taps, table, table.Initial(), initial_reach, m, 0, Position::Start.y, target, ret[q]);
+      continue;
+    }
+    // the premove must be an initial entry that can still adjust (see MoveSearchInternal)
+    for (int i = 0; i < table.Initial().size; i++) {
+      const Phase1Entry& entry = table.Entry(i);
+      if (entry.rot != premove.r || entry.col != premove.y) continue;
+      int frame = std::max(adj_frame, taps[entry.num_taps]);
+      if (GetRow(frame, level) != premove.x || !(initial_reach >> i & 1)) break;
+      int start_frame = entry.num_taps == 0 ? 0 : taps[entry.num_taps - 1];
+      int lock_row = FindLockRow(m.cols[entry.rot][entry.col], GetRow(start_frame, level));
+      if (GetLastFrameOnRow(lock_row, level) + 1 <= frame) break;
+      if (!(adj_done >> i & 1)) {
+        adj_reach[i] = table.CanReach<R>(board, table.Adj(i));
+        adj_done |= 1ull << i;
+      }
+      CheckTarget<R, level, mode>(
+          true, entry.num_taps, adj_frame, taps, table, table.Adj(i), adj_reach[i], m, entry.rot, entry.col, target,
+          ret[q]);
+      break;
+    }
+  }
+}
+
+template <int R, PextMode mode>
+void IsReachableLevel(
+    Level level, int adj_frame, const int taps[], const Phase1TableNoTmpl& table, const std::array<Board, R>& board,
+    int n, const PlacementQuery queries[], PlacementCheck ret[]) {
+#define ONE_CASE(x) case x: return IsReachableInternal<R, x, mode>(adj_frame, taps, table, board, n, queries, ret);
+  DO_LEVEL_CASE(level);
+#undef ONE_CASE
+}
+
+} // namespace move_search
+
+#ifdef HAS_BMI2_PATH
+template <int R>
+TARGET_BMI2 __attribute__((flatten)) void IsReachableHardwarePext(
+    Level level, int adj_frame, const int taps[], const PrecomputedTable& table, const std::array<Board, R>& board,
+    int n, const PlacementQuery queries[], PlacementCheck ret[]) {
+  move_search::IsReachableLevel<R, PextMode::kHardware>(level, adj_frame, taps, table, board, n, queries, ret);
+}
+#endif
+
+template <int R>
+NOINLINE void IsReachable(
+    Level level, int adj_frame, const int taps[], const PrecomputedTable& table, const std::array<Board, R>& board,
+    int n, const PlacementQuery queries[], PlacementCheck ret[]) {
+#ifdef HAS_BMI2_PATH
+  if (HardwarePextIsFast()) return IsReachableHardwarePext<R>(level, adj_frame, taps, table, board, n, queries, ret);
+#endif
+  move_search::IsReachableLevel<R, PextMode::kSoftware>(level, adj_frame, taps, table, board, n, queries, ret);
+}
+
+// Check n placements of piece on b at once; the board is preprocessed only
+//   once. Does not allocate.
+inline void IsReachable(
+    Level level, int adj_frame, const int taps[], const PrecomputedTableTuple& table,
+    const Board& b, int piece, int n, const PlacementQuery queries[], PlacementCheck ret[]) {
+#define ONE_CASE(x) \
+    case x: { \
+      constexpr int R = Board::NumRotations(x); \
+      return IsReachable<R>(level, adj_frame, taps, table[R], b.PieceMap<x>(), n, queries, ret); \
+    }
+  DO_PIECE_CASE(piece);
+#undef ONE_CASE
+}
+
+inline PlacementCheck IsReachable(
+    Level level, int adj_frame, const int taps[], const PrecomputedTableTuple& table,
+    const Board& b, int piece, const Position& target, const Position& premove = Position::Invalid) {
+  PlacementQuery query{target, premove};
+  PlacementCheck ret;
+  IsReachable(level, adj_frame, taps, table, b, piece, 1, &query, &ret);
+  return ret;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+// For every placement, the adj frames at which it can be reached with each of
+//   a list of tap tables; this answers "how fast do I need to tap and how late
+//   can I react" without searching once per adj frame.
+//
+// The search of move_search_no_tmpl.h tests the masks of a Phase1 table that
+//   is generated for one adj frame. Here the same tables are followed in frame
+//   space instead: the frame masks tell on which frames each (rot, col) is
+//   empty, so one Frames word per table entry holds, for every adjustment
+//   frame at once (bit s), whether the entry can be reached. Lock rows and tucks
+//   are then resolved from these words with the usual frame and tuck masks.
+
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#include "move_search_no_tmpl.h"
+
+class ReachabilityFrontier {
+ public:
+  using Frames = move_search::Frames;
+  static constexpr int kUnreachable = -1;
+  // table[(r * 20 + x) * 10 + y] for Position{r, x, y}; bit f is set if the
+  //   position is reachable when the adjustment starts on frame f
+  using Table = std::array<Frames, 4 * 20 * 10>;
+
+  struct Result {
+    // reachable after adjusting; this is not monotone in the adj frame (a
+    //   later adjustment can reach a tuck that an earlier one cannot, and the
+    //   other way around)
+    Table adj;
+    // reachable by the initial inputs alone, so at any adj frame (all bits set)
+    Table without_adj;
+  };
+
+ private:
+  std::vector<Result> results_;
+
+  static constexpr int Index_(const Position& pos) { return (pos.r * 20 + pos.x) * 10 + pos.y; }
+
+ public:
+  // one result per tap table, all unreachable
+  void Reset(int num_taps) {
+    results_.resize(num_taps);
+    for (auto& i : results_) {
+      i.adj.fill(0);
+      i.without_adj.fill(0);
+    }
+  }
+  int NumTaps() const { return results_.size(); }
+  Result& operator[](int t) { return results_[t]; }
+  const Result& operator[](int t) const { return results_[t]; }
+
+  // the adj frames (bit f) at which pos is reachable with tap table t
+  Frames AdjFrames(int t, const Position& pos) const {
+    return results_[t].adj[Index_(pos)] | results_[t].without_adj[Index_(pos)];
+  }
+  // the latest adj frame at which pos is reachable after adjusting, or kUnreachable
+  int LatestAdjFrame(int t, const Position& pos) const {
+    Frames x = results_[t].adj[Index_(pos)];
+    return x ? 63 - clz(x) : kUnreachable;
+  }
+  bool ReachableWithoutAdj(int t, const Position& pos) const { return results_[t].without_adj[Index_(pos)]; }
+  // whether pos can be reached with tap table t when the adjustment starts on
+  //   adj_frame; no piece can adjust after frame 63, and bit 63 of the adj
+  //   masks is never set
+  bool Reachable(int t, const Position& pos, int adj_frame) const {
+    return AdjFrames(t, pos) >> std::clamp(adj_frame, 0, 63) & 1;
+  }
+  // the first tap table (so the slowest if they are ordered from slow to fast)
+  //   that reaches pos with adj_frame, or -1
+  int SlowestTaps(const Position& pos, int adj_frame) const {
+    for (int t = 0; t < NumTaps(); t++) {
+      if (Reachable(t, pos, adj_frame)) return t;
+    }
+    return -1;
+  }
+};
+
+namespace move_search {
+
+// Phase1TableGen entry that keeps the tree structure (the entry each one is
+//   tapped from); the masks are not used
+struct TreeEntry {
+  uint8_t rot, col, prev, num_taps;
+  bool cannot_finish;
+  std::array<Board, 4> masks, masks_nodrop;
+};
+
+// Start frames collected from the tables, per (rot, col) and tap count:
+//   bit u of lock[rot][col][k] is set if a piece tapped k times can be in
+//   (rot, col) on frame u = s + taps[k-1] right after its last tap, and of
+//   tuck[rot][col][k] if it can still be there on frame s + taps[k], where the
+//   next input is allowed; s is the frame the table started at.
+template <int R>
+struct FrameStarts {
+  Frames lock[R][10][10], tuck[R][10][10];
+};
+
+// shifts by a tap frame, which is not bounded by the width of Frames
+constexpr Frames ShiftRight(Frames m, int n) { return n < 64 ? m >> n : 0; }
+constexpr Frames ShiftLeft(Frames m, int n) { return n < 64 ? m << n : 0; }
+
+constexpr Frames FrameWindow(Frames m, int len) {
+  // bit s is set if bits [s, s+len) of m are all set
+  Frames ret = ~(Frames)0;
+  for (int i = 0; i < len && ret; i++) ret &= ShiftRight(m, i);
+  return ret;
+}
+
+// Follow the table rooted at (rot, col) that starts on the frames in start
+template <int R>
+void CollectFrameStarts(
+    Level level, const int taps[], int rot, int col, Frames start,
+    const FrameMasks<R>& m, FrameStarts<R>& out) {
+  TreeEntry entries[10 * R];
+  int N = Phase1TableGen<R>(level, taps, 0, rot, col, entries);
+  Frames full[10 * R];
+  for (int i = 0; i < N; i++) {
+    const TreeEntry& e = entries[i];
+    int prot = i ? entries[e.prev].rot : e.rot;
+    int k = e.num_taps;
+    int a = k ? taps[k - 1] : 0, b = taps[k];
+    // the cells of the last tap, then falling until the next input
+    Frames reach = (i ? full[e.prev] : start) & ShiftRight(m.frame[prot][e.col] & m.frame[e.rot][e.col], a);
+    full[i] = reach & ShiftRight(FrameWindow(m.drop[e.rot][e.col], b - a), a);
+    out.lock[e.rot][e.col][k] |= ShiftLeft(reach, a);
+    out.tuck[e.rot][e.col][k] |= ShiftLeft(full[i], b);
+  }
+}
+
+// Turn the start frames into lock positions; value(s) is the set of adj frames
+//   (as a Frames mask) that start a table on frame s, and each position gets
+//   the union of the values that lead to it in out
+template <int R, Level level, class Value>
+void ResolveFrameStarts(
+    const int taps[], const Column cols[R][10], const FrameMasks<R>& m, const TuckMasks<R>& tuck_masks,
+    const FrameStarts<R>& starts, const Value& value, ReachabilityFrontier::Table& out) {
+  constexpr TuckTypeTable<R> tucks;
+  constexpr int total_frames = GetLastFrameOnRow(19, level) + 1;
+  auto Update = [&](int rot, int col, int frame, Frames val) {
+    int row = FindLockRow(cols[rot][col], GetRow(frame, level));
+    out[(rot * 20 + row) * 10 + col] |= val;
+  };
+  // offset(k) is the frame of the start bit relative to s
+  auto Collect = [&](const Frames masks[10], int u, auto offset) {
+    Frames ret = 0;
+    for (int k = 0; k < 10; k++) {
+      if (masks[k] >> u & 1) ret |= value(u - offset(k));
+    }
+    return ret;
+  };
+  auto LockOffset = [&](int k) { return k ? taps[k - 1] : 0; };
+  auto TuckOffset = [&](int k) { return taps[k]; };
+  for (int rot = 0; rot < R; rot++) {
+    for (int col = 0; col < 10; col++) {
+      Frames lock = 0, tuck = 0;
+      for (int k = 0; k < 10; k++) {
+        lock |= starts.lock[rot][col][k];
+        tuck |= starts.tuck[rot][col][k];
+      }
+      for (Frames x = lock; x; x &= x - 1) {
+        int u = ctz(x);
+        Update(rot, col, u, Collect(starts.lock[rot][col], u, LockOffset));
+      }
+      if (!tuck) continue;
+      // a tuck on frame t can follow any start frame u <= t from which the
+      //   piece falls to t; vals is the union of the values of those
+      Frames vals = 0;
+      for (int t = ctz(tuck); t < total_frames; t++) {
+        if (t && !(m.drop[rot][col] >> (t - 1) & 1)) vals = 0;
+        if (tuck >> t & 1) vals |= Collect(starts.tuck[rot][col], t, TuckOffset);
+        if (!vals) continue;
+        for (int i = 0; i < TuckTypes(R); i++) {
+          const auto& type = tucks.table[i];
+          int ncol = col + type.delta_col;
+          if (ncol < 0 || ncol >= 10 || !(tuck_masks[i][rot][col] >> t & 1)) continue;
+          Update((rot + type.delta_rot) % R, ncol, t + type.delta_frame, vals);
+        }
+      }
+    }
+  }
+}
+
+template <int R, Level level, PextMode mode>
+void ReachabilityInternal(
+    int n, const int* const taps[], const std::array<Board, R>& board, ReachabilityFrontier& ret) {
+  constexpr int total_frames = GetLastFrameOnRow(19, level) + 1;
+  Column cols[R][10] = {};
+  auto frame_masks = GetColsAndFrameMasks<R, level, mode>(board, cols);
+  auto tuck_masks = GetTuckMasks<R>(frame_masks);
+
+  for (int t = 0; t < n; t++) {
+    const int* tap = taps[t];
+    auto& result = ret[t];
+    // without adjustment: the table of the initial position started on frame 0
+    FrameStarts<R> initial = {};
+    CollectFrameStarts<R>(level, tap, 0, Position::Start.y, 1, frame_masks, initial);
+    ResolveFrameStarts<R, level>(
+        tap, cols, frame_masks, tuck_masks, initial, [](int) { return ~(Frames)0; }, result.without_adj);
+
+    // Adjusting on frame f from an initial entry with k taps starts its adj
+    //   table on frame s = max(f, taps[k]), as long as the piece has not locked
+    //   by then. So a table started on s > taps[k] belongs to adj frame s only,
+    //   and the one started on taps[k] to every adj frame up to taps[k]. The
+    //   two are collected apart, since entries with other tap counts mix in
+    //   the same start bits.
+    FrameStarts<R> adj_late = {}, adj_early = {};
+    for (int rot = 0; rot < R; rot++) {
+      for (int col = 0; col < 10; col++) {
+        for (int k = 0; k < 10; k++) {
+          if (!(ShiftRight(initial.lock[rot][col][k], k ? tap[k - 1] : 0) & 1)) continue;
+          int row = FindLockRow(cols[rot][col], GetRow(k ? tap[k - 1] : 0, level));
+          int lock_frame = std::min(GetLastFrameOnRow(row, level) + 1, total_frames);
+          if (lock_frame <= tap[k]) continue;
+          Frames start = ((Frames)1 << lock_frame) - ((Frames)1 << tap[k]);
+          CollectFrameStarts<R>(level, tap, rot, col, start, frame_masks, adj_late);
+          if (tap[k]) CollectFrameStarts<R>(level, tap, rot, col, (Frames)1 << tap[k], frame_masks, adj_early);
+        }
+      }
+    }
+    ResolveFrameStarts<R, level>(
+        tap, cols, frame_masks, tuck_masks, adj_late, [](int s) { return (Frames)1 << s; }, result.adj);
+    ResolveFrameStarts<R, level>(
+        tap, cols, frame_masks, tuck_masks, adj_early, [](int s) { return ((Frames)1 << s) - 1; }, result.adj);
+  }
+}
+
+template <int R, PextMode mode>
+void ReachabilityLevel(
+    Level level, int n, const int* const taps[], const std::array<Board, R>& board, ReachabilityFrontier& ret) {
+#define ONE_CASE(x) case x: return ReachabilityInternal<R, x, mode>(n, taps, board, ret);
+  DO_LEVEL_CASE(level);
+#undef ONE_CASE
+}
+
+} // namespace move_search
+
+#ifdef HAS_BMI2_PATH
+template <int R>
+TARGET_BMI2 __attribute__((flatten)) void ReachabilityHardwarePext(
+    Level level, int n, const int* const taps[], const std::array<Board, R>& board, ReachabilityFrontier& ret) {
+  move_search::ReachabilityLevel<R, PextMode::kHardware>(level, n, taps, board, ret);
+}
+#endif
+
+template <int R>
+NOINLINE void ComputeReachabilityFrontier(
+    Level level, int n, const int* const taps[], const std::array<Board, R>& board, ReachabilityFrontier& ret) {
+#ifdef HAS_BMI2_PATH
+  if (HardwarePextIsFast()) return ReachabilityHardwarePext<R>(level, n, taps, board, ret);
+#endif
+  move_search::ReachabilityLevel<R, PextMode::kSoftware>(level, n, taps, board, ret);
+}
+
+// Fill ret[i] with the reachability of every placement of piece on b with
+//   taps[i], for all adj frames at once. This agrees with searching once per
+//   adj frame (adj frames up to 63), but needs no precomputed tables.
+inline void ComputeReachabilityFrontier(
+    Level level, int n, const int* const taps[], const Board& b, int piece, ReachabilityFrontier& ret) {
+  ret.Reset(n);
+#define ONE_CASE(x) \
+    case x: return ComputeReachabilityFrontier<Board::NumRotations(x)>(level, n, taps, b.PieceMap<x>(), ret);
+  DO_PIECE_CASE(piece);
+#undef ONE_CASE
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <vector>
+#include <cstring>
+
+#include "board_hash.h"
+#include "move_search_no_tmpl.h"
+
+struct Successor {
+  Board board; // lines already cleared
+  uint64_t hash; // std::hash<Board>()(board)
+  int lines;
+  // range of the placements leading to this board in Successors::positions
+  int first_position, num_positions;
+};
+
+// Output of GenerateSuccessors. Reuse one object across calls so that its
+//   storage is allocated only once.
+class Successors {
+  static constexpr int kTableSize_ = 2048; // more than twice the number of positions
+  static constexpr uint16_t kEmpty_ = 0xffff;
+  static constexpr int kPositions_ = 4 * 20 * 10;
+
+  std::array<uint16_t, kTableSize_> table_;
+  std::array<uint64_t, (kPositions_ + 63) / 64> seen_;
+  std::vector<std::pair<uint16_t, Position>> placements_;
+
+  template <class Func>
+  static void ForEachPosition_(const PossibleMoves& moves, Func&& func) {
+    for (auto& i : moves.non_adj) func(i);
+    for (auto& i : moves.adj) {
+      for (auto& j : i.second) func(j);
+    }
+  }
+  template <class Func>
+  static void ForEachPosition_(const CompactPossibleMoves& moves, Func&& func) {
+    for (auto i : moves.NonAdj()) func(i);
+    for (int i = 0; i < moves.NumAdj(); i++) {
+      for (auto j : moves.Adj(i)) func(j);
+    }
+  }
+
+ public:
+  std::vector<Successor> boards;
+  std::vector<Position> positions;
+
+  size_t size() const { return boards.size(); }
+  const Successor& operator[](size_t i) const { return boards[i]; }
+  std::span<const Position> Positions(const Successor& s) const {
+    return {positions.data() + s.first_position, (size_t)s.num_positions};
+  }
+
+  // fill with the distinct boards reachable by placing `piece` according to `moves`
+  // (PossibleMoves or CompactPossibleMoves)
+  template <class Moves>
+  void Generate(const Board& b, int piece, const Moves& moves) {
+    boards.clear();
+    positions.clear();
+    placements_.clear();
+    memset(table_.data(), 0xff, sizeof(table_));
+    memset(seen_.data(), 0, sizeof(seen_));
+    HashedBoard start(b);
+    ForEachPosition_(moves, [&](const Position& pos) {
+      // a position can be reached both with and without adjustment
+      int id = (pos.r * 20 + pos.x) * 10 + pos.y;
+      if (seen_[id / 64] >> (id % 64) & 1) return;
+      seen_[id / 64] |= 1ull << (id % 64);
+      auto [lines, nxt] = start.Place(piece, pos.r, pos.x, pos.y).ClearLines();
+      uint64_t hash = nxt.hash.Value();
+      size_t slot = hash % kTableSize_;
+      while (table_[slot] != kEmpty_ && boards[table_[slot]].board != nxt.board) {
+        slot = (slot + 1) % kTableSize_;
+      }
+      if (table_[slot] == kEmpty_) {
+        table_[slot] = boards.size();
+        boards.push_back({nxt.board, hash, lines, 0, 0});
+      }
+      boards[table_[slot]].num_positions++;
+      placements_.emplace_back(table_[slot], pos);
+    });
+    // group the positions by board
+    int offset = 0;
+    for (auto& i : boards) {
+      i.first_position = offset;
+      offset += i.num_positions;
+      i.num_positions = 0;
+    }
+    positions.resize(offset);
+    for (auto& [idx, pos] : placements_) {
+      Successor& s = boards[idx];
+      positions[s.first_position + s.num_positions++] = pos;
+    }
+  }
+};
+
+// Distinct boards (with lines cleared) after placing `piece` on `b`, each with
+//   its hash and all placements that produce it.
+inline void GenerateSuccessors(
+    Level level, int adj_frame, const int taps[], const PrecomputedTableTuple& table,
+    const Board& b, int piece, Successors& ret) {
+  CompactPossibleMoves moves;
+  MoveSearch(level, adj_frame, taps, table, b, piece, moves);
+  ret.Generate(b, piece, moves);
+}
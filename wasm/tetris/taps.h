@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+#include <iterator>
+
+// the tap speed presets of the web app
+enum TapSpeed {
+  kTap10Hz,
+  kTap12Hz,
+  kTap15Hz,
+  kTap20Hz,
+  kTap24Hz,
+  kTap30Hz,
+  kSlow5
+};
+constexpr std::array<int, 10> kTapTables[] = { // match TapSpeed
+  {0, 6, 12, 18, 24, 30, 36, 42, 48, 54},
+  {0, 5, 10, 15, 20, 25, 30, 35, 40, 45},
+  {0, 4, 8, 12, 16, 20, 24, 28, 32, 36},
+  {0, 3, 6, 9, 12, 15, 18, 21, 24, 27},
+  {0, 3, 5, 8, 10, 13, 15, 18, 20, 23},
+  {0, 2, 4, 6, 8, 10, 12, 14, 16, 18},
+  {0, 2, 4, 6, 18, 20, 22, 24, 36, 38}
+};
+constexpr int kTapSpeeds = std::size(kTapTables);
+static_assert(kTapSpeeds == kSlow5 + 1);